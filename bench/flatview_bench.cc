@@ -0,0 +1,241 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+// Microbenchmarks for the FlatView navigation primitives
+// Reports the time and the number of heap allocations per operation
+
+#include "gbl.hh"
+#include "gbl_flatview.hh"
+#include "gbl_flatnets.hh"
+#include "gbl_flatcones.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <random>
+#include <vector>
+
+using namespace gbl;
+
+namespace {
+std::atomic<std::uint64_t> allocCount(0);
+}
+
+void* operator new(std::size_t sz) {
+    ++allocCount;
+    void* ret = std::malloc(sz);
+    if (ret == nullptr) throw std::bad_alloc();
+    return ret;
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+// Sink to keep the compiler from optimizing the benchmarked calls away
+volatile FlatSize sink;
+
+// Hierarchical index of a flat node, without creating a refcounted Module
+Size nodeIndex(FlatNode node) {
+    return node.getObject().ref()._ind;
+}
+
+template<class F>
+void bench(const char* name, std::size_t numOps, F f) {
+    // Warmup
+    f();
+    std::uint64_t allocBefore = allocCount;
+    auto start = std::chrono::steady_clock::now();
+    std::size_t reps = 0;
+    double elapsed = 0.0;
+    do {
+        f();
+        ++reps;
+        elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < 2e8);
+    std::uint64_t allocs = allocCount - allocBefore;
+    double ops = static_cast<double>(reps) * numOps;
+    std::printf("%-38s %8.2f ns/op %8.3f allocs/op\n", name, elapsed / ops, allocs / ops);
+}
+
+// Balanced hierarchy: each level instanciates the next one several times, with wires and ports on each module
+// Instances don't keep their module alive, so the caller owns all of them
+void buildDesign(std::vector<Module>& mods, int depth, int fanout, int numPorts, int numWires) {
+    for (int i=0; i<depth; ++i) {
+        mods.push_back(Module::createHier());
+    }
+    mods.push_back(Module::createLeaf());
+    for (Module mod : mods) {
+        for (int j=0; j<numPorts; ++j) {
+            mod.createPort();
+        }
+    }
+    for (int i=0; i<depth; ++i) {
+        std::vector<Wire> wires;
+        for (int j=0; j<numWires; ++j) {
+            wires.push_back(mods[i].createWire());
+        }
+        for (int j=0; j<fanout; ++j) {
+            Instance inst = mods[i].createInstance(mods[i+1]);
+            int k = j;
+            for (Port port : inst.ports()) {
+                port.connect(wires[k++ % numWires]);
+            }
+        }
+    }
+}
+} // End anonymous namespace
+
+int main() {
+    std::vector<Module> mods;
+    buildDesign(mods, 4, 8, 8, 16);
+    FlatView view(mods.front());
+
+    std::vector<FlatModule> modules;
+    std::vector<FlatInstance> instances;
+    std::vector<FlatWire> wires;
+    std::vector<FlatModulePort> modPorts;
+    std::vector<FlatInstancePort> instPorts;
+    for (FlatSize i=1; i<view.getNumFlatModules(); ++i) {
+        modules.push_back(view.getFlatModuleByIndex(i));
+        instances.push_back(view.getFlatInstanceByIndex(i));
+    }
+    for (FlatSize i=0; i<view.getNumFlatWires(); ++i) {
+        wires.push_back(view.getFlatWireByIndex(i));
+    }
+    for (FlatSize i=0; i<view.getNumFlatPorts(); ++i) {
+        FlatModulePort port = view.getFlatModulePortByIndex(i);
+        if (!port.isTopPort()) {
+            modPorts.push_back(port);
+            instPorts.push_back(port.getUpPort());
+        }
+    }
+    std::printf("%llu flat modules, %llu flat wires, %llu flat ports\n",
+        (unsigned long long) view.getNumFlatModules(),
+        (unsigned long long) view.getNumFlatWires(),
+        (unsigned long long) view.getNumFlatPorts()
+    );
+
+    bench("FlatModule::getUpInstance", modules.size(), [&]() {
+        for (FlatModule mod : modules) sink = nodeIndex(mod.getUpInstance());
+    });
+    bench("FlatInstance::getDownModule", instances.size(), [&]() {
+        for (FlatInstance inst : instances) sink = nodeIndex(inst.getDownModule());
+    });
+    bench("FlatModulePort::getUpPort", modPorts.size(), [&]() {
+        for (FlatModulePort port : modPorts) sink = port.getUpPort().getObject().ref()._instInd;
+    });
+    bench("FlatInstancePort::getDownPort", instPorts.size(), [&]() {
+        for (FlatInstancePort port : instPorts) sink = port.getDownPort().getObject().ref()._portInd;
+    });
+    bench("FlatNode::getIndex (module)", modules.size(), [&]() {
+        for (FlatModule mod : modules) sink = mod.getIndex();
+    });
+    bench("FlatNode::getIndex (instance)", instances.size(), [&]() {
+        for (FlatInstance inst : instances) sink = inst.getIndex();
+    });
+    bench("FlatWire::getIndex", wires.size(), [&]() {
+        for (FlatWire wire : wires) sink = wire.getIndex();
+    });
+    bench("FlatPort::getIndex (module port)", modPorts.size(), [&]() {
+        for (FlatModulePort port : modPorts) sink = port.getIndex();
+    });
+    bench("FlatPort::getIndex (instance port)", instPorts.size(), [&]() {
+        for (FlatInstancePort port : instPorts) sink = port.getIndex();
+    });
+    bench("FlatView::getFlatModuleByIndex", modules.size(), [&]() {
+        for (FlatSize i=1; i<view.getNumFlatModules(); ++i) sink = nodeIndex(view.getFlatModuleByIndex(i));
+    });
+    bench("FlatView::getFlatInstanceByIndex", modules.size(), [&]() {
+        for (FlatSize i=1; i<view.getNumFlatModules(); ++i) sink = nodeIndex(view.getFlatInstanceByIndex(i));
+    });
+    bench("FlatView::getFlatWireByIndex", wires.size(), [&]() {
+        for (FlatSize i=0; i<view.getNumFlatWires(); ++i) sink = view.getFlatWireByIndex(i).getObject().ref()._ind;
+    });
+    bench("FlatView::getFlatModulePortByIndex", view.getNumFlatPorts(), [&]() {
+        for (FlatSize i=0; i<view.getNumFlatPorts(); ++i) sink = view.getFlatModulePortByIndex(i).getObject().ref()._portInd;
+    });
+    bench("FlatView::getFlatInstancePortByIndex", instPorts.size(), [&]() {
+        for (FlatSize i=view.getNumFlatPorts() - instPorts.size(); i<view.getNumFlatPorts(); ++i) sink = view.getFlatInstancePortByIndex(i).getObject().ref()._portInd;
+    });
+
+    std::vector<FlatSize> indexes;
+    for (FlatSize i=0; i<view.getNumFlatWires(); ++i) {
+        indexes.push_back(i);
+    }
+    std::vector<DecodedFlatIndex> decoded(indexes.size());
+    bench("FlatView::decodeWireIndexes (sorted)", indexes.size(), [&]() {
+        view.decodeWireIndexes(indexes.data(), indexes.data() + indexes.size(), decoded.data());
+        sink = decoded.back()._occurrence;
+    });
+    std::shuffle(indexes.begin(), indexes.end(), std::mt19937(0));
+    bench("FlatView::decodeWireIndexes (random)", indexes.size(), [&]() {
+        view.decodeWireIndexes(indexes.data(), indexes.data() + indexes.size(), decoded.data());
+        sink = decoded.back()._occurrence;
+    });
+
+    // Small edits, compared to a full construction
+    bench("FlatView::FlatView", 1, [&]() {
+        FlatView fresh(mods.front());
+        sink = fresh.getNumFlatWires();
+    });
+    bench("FlatView::FlatView (lazy)", 1, [&]() {
+        FlatView fresh(mods.front(), true);
+        sink = fresh.getNumFlatWires();
+    });
+    bench("FlatView::update (wire edit)", 1, [&]() {
+        Wire wire = mods[2].createWire();
+        view.update();
+        wire.destroy();
+        view.update();
+        sink = view.getNumFlatWires();
+    });
+    bench("FlatView::update (instance edit)", 1, [&]() {
+        Instance inst = mods[3].createInstance(mods[4]);
+        view.update();
+        inst.destroy();
+        view.update();
+        sink = view.getNumFlatWires();
+    });
+
+    // Instance edits in a large flat module only renumber the instanciated module
+    std::vector<Module> flatMods;
+    buildDesign(flatMods, 1, 500000, 2, 16);
+    FlatView flatView(flatMods.front());
+    bench("FlatView::FlatView (large module)", 1, [&]() {
+        FlatView fresh(flatMods.front());
+        sink = fresh.getNumFlatWires();
+    });
+    bench("FlatView::update (large module)", 1, [&]() {
+        Instance inst = flatMods[0].createInstance(flatMods[1]);
+        flatView.update();
+        inst.destroy();
+        flatView.update();
+        sink = flatView.getNumFlatWires();
+    });
+
+    // Whole-design extraction, per flat port
+    bench("FlatNets::FlatNets", view.getNumFlatPorts(), [&]() {
+        FlatNets nets(view);
+        sink = nets.getNumNets();
+    });
+
+    // Fan-out of 64 sources at once, per flat node
+    FlatNets nets(view);
+    FlatCones cones(view, nets);
+    std::vector<FlatSize> sources;
+    for (FlatSize i=0; i<64; ++i) {
+        sources.push_back(i * cones.getNumNodes() / 64);
+    }
+    std::vector<std::uint64_t> reached;
+    bench("FlatCones::propagate", cones.getNumNodes(), [&]() {
+        cones.propagate(sources, FlatCones::FanOut, reached);
+        sink = reached.size();
+    });
+    return 0;
+}
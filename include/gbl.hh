@@ -5,6 +5,8 @@
 
 #include "private/gbl_forward_declarations.hh"
 
+#include <vector>
+
 namespace gbl {
 
 /************************************************************************
@@ -15,15 +17,28 @@ class Wire {
   public:
   typedef internal::WirePortIterator  PortIterator;
   typedef Container<PortIterator>     Ports;
+  typedef internal::WireLoadIterator  LoadIterator;
+  typedef Container<LoadIterator>     Loads;
 
   public:
   void disconnectAll();
   void destroy();
   Module getParentModule();
 
+  // Move all the connections to another wire of the module, and destroy this one
+  void mergeInto(Wire target);
+  // Move some of the ports connected to this wire to a new wire
+  Wire split(const std::vector<Port>& ports);
+
   // Access
   Ports ports();
 
+  // Port driving the wire: an instance port with direction DIR_OUT or a module port with direction DIR_IN
+  // Invalid if there is none; the first one if there are several
+  Port getDriver();
+  // All the other ports
+  Loads loads();
+
   bool hasName(ID id);
   bool hasProperty(ID id);
   bool addName(ID id);
@@ -31,6 +46,11 @@ class Wire {
   bool eraseName(ID id);
   bool eraseProperty(ID id);
 
+  bool hasAttribute(ID id);
+  std::int64_t getAttribute(ID id);
+  bool setAttribute(ID id, std::int64_t val);
+  bool eraseAttribute(ID id);
+
   Names names();
   Properties properties();
 
@@ -72,6 +92,11 @@ class Node {
   bool eraseName(ID id);
   bool eraseProperty(ID id);
 
+  bool hasAttribute(ID id);
+  std::int64_t getAttribute(ID id);
+  bool setAttribute(ID id, std::int64_t val);
+  bool eraseAttribute(ID id);
+
   Names names();
   Properties properties();
 
@@ -112,10 +137,17 @@ class Module : public Node {
   bool isHier();
   ModulePort createPort();
 
+  // For each port index of this module, index of a port of the other module with a common name, or InvalidIndex
+  std::vector<Size> getPortMappingByName(Module other);
+
   // Only for non-leaf modules
   Wire     createWire();
   Instance createInstance(Module instanciated);
 
+  // Destruction of many distinct objects at once, with a single notification
+  void destroyInstances(const std::vector<Instance>& instances);
+  void destroyWires(const std::vector<Wire>& wires);
+
   // Access
   Ports ports();
   Wires wires();
@@ -144,7 +176,10 @@ class Instance : public Node {
   // Access
   Ports ports();
 
+  // Instanciate another module in place: the index, the data and the connections of the ports with the same index are kept
   void replaceModule(Module mod);
+  // Same, with the port i of the instance becoming its port portMap[i]; unmapped ports are disconnected
+  void replaceModule(Module mod, const std::vector<Size>& portMap);
 
   Instance() {}
   explicit Instance(const Node& n);
@@ -163,6 +198,11 @@ class Port {
   bool eraseName(ID id);
   bool eraseProperty(ID id);
 
+  bool hasAttribute(ID id);
+  std::int64_t getAttribute(ID id);
+  bool setAttribute(ID id, std::int64_t val);
+  bool eraseAttribute(ID id);
+
   Names names();
   Properties properties();
 
@@ -170,6 +210,11 @@ class Port {
   Node getNode();
   Wire getWire();
 
+  // Direction of the module port (Symbol::DIR_*), or 0 if unknown
+  // The direction follows the DIR_* properties of the module port: the last one added is the
+  // direction, and erasing it falls back to another DIR_* property of the port, if any
+  ID getDirection();
+
   bool isInstancePort();
   bool isModulePort();
 
@@ -199,6 +244,8 @@ class InstancePort : public Port {
 class ModulePort : public Port {
   public:
   void destroy();
+  // Replaces the DIR_* properties of the port by dir, or erases them if dir is 0
+  void setDirection(ID dir);
 
   InstancePort getUpPort(Instance inst);
 
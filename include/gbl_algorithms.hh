@@ -0,0 +1,29 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_ALGORITHMS_HH
+#define GBL_ALGORITHMS_HH
+
+#include "gbl.hh"
+
+namespace gbl {
+
+/************************************************************************
+ * Parallel traversal of the netlist containers
+ *
+ * The traversal is split in chunks of the underlying storage, balanced
+ * with its occupancy counts: no copy of the objects is needed. Chunks
+ * only depend on the netlist, not on the number of threads.
+ *
+ * The container must not be modified during the traversal.
+ ************************************************************************/
+
+// Runs func(object) for each object of the container, e.g. parallelForEach(module.instances(), f)
+template<class Iterator, class Func>
+void parallelForEach(const Container<Iterator>& objects, Func func);
+
+} // End namespace gbl
+
+#include "private/gbl_algorithms_impl.hh"
+
+#endif
+
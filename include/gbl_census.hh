@@ -0,0 +1,61 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_CENSUS_HH
+#define GBL_CENSUS_HH
+
+#include "gbl_flatview.hh"
+
+#include <vector>
+
+namespace gbl {
+
+/************************************************************************
+ * Number of flat occurrences of each leaf module
+ *
+ * Each instance of a leaf module accounts for as many flat instances as
+ * its parent module has occurrences: the census only visits the
+ * hierarchical instances, never the flat ones. The top module is not an
+ * instance: a view of a leaf module has an empty census.
+ *
+ * An attribute can be summed over the flat instances at the same time.
+ * The value of a flat instance is the attribute of its hierarchical
+ * instance, or of the leaf module if the instance doesn't have it, or 0.
+ *
+ * The census is a snapshot: it is stale once the view is renumbered (see
+ * FlatView::getEpoch), and must not be accessed anymore. Attribute edits
+ * are not tracked.
+ ************************************************************************/
+
+class LeafCensus {
+  public:
+  explicit LeafCensus(const FlatView& view);
+  LeafCensus(const FlatView& view, ID attribute);
+
+  // True if the view was renumbered since the census was computed
+  bool isStale() const { return _epoch != _view.getEpoch(); }
+
+  // Leaf modules with at least one flat instance, in hierarchy order
+  Size size() const { assert(!isStale()); return _modules.size(); }
+  Module getModule(Size index) const { assert(!isStale()); return _modules[index]; }
+  FlatSize getCount(Size index) const { assert(!isStale()); return _counts[index]; }
+  std::int64_t getAttributeSum(Size index) const { assert(!isStale()); return _sums[index]; }
+
+  // Totals over all leaf modules
+  FlatSize getTotalCount() const;
+  std::int64_t getTotalAttributeSum() const;
+
+  private:
+  void compute(bool hasAttribute, ID attribute);
+
+  private:
+  const FlatView&           _view;
+  std::uint64_t             _epoch;
+  std::vector<Module>       _modules;
+  std::vector<FlatSize>     _counts;
+  std::vector<std::int64_t> _sums;
+};
+
+} // End namespace gbl
+
+#endif
+
@@ -0,0 +1,68 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_CONCURRENCY_HH
+#define GBL_CONCURRENCY_HH
+
+#include "gbl.hh"
+
+namespace gbl {
+
+/************************************************************************
+ * Concurrent access to modules
+ *
+ * Modules are independent: different threads may read and edit different
+ * modules at the same time without synchronization. Instanciating a module
+ * or building a flat view through it only reads it. The state shared by
+ * all modules (reference counts, identifiers, hierarchy caches) is
+ * synchronized.
+ *
+ * A module edited by several threads at once needs its writers to hold a
+ * ModuleWriteGuard: they are serialized, and the module version is odd
+ * for the duration of the write.
+ *
+ * Readers of a module that is being edited don't block: a ModuleReadSection
+ * records the version, and validate() tells whether a write started since.
+ * Values read in a section that fails validation may be torn and must be
+ * discarded. Creations may reallocate the storage of the module, so that a
+ * section that may overlap them must only read values the reader already
+ * knows the location of, such as the version of the data it derived earlier.
+ ************************************************************************/
+
+class ModuleWriteGuard {
+  public:
+  explicit ModuleWriteGuard(Module module);
+  ~ModuleWriteGuard();
+
+  ModuleWriteGuard(const ModuleWriteGuard&) = delete;
+  ModuleWriteGuard& operator=(const ModuleWriteGuard&) = delete;
+
+  private:
+  Module _module;
+};
+
+class ModuleReadSection {
+  public:
+  // Waits for the end of the current write, if any
+  explicit ModuleReadSection(Module module);
+
+  // True if the module was not written since the beginning of the section
+  bool validate() const;
+  // Begins a new section after a failed validation
+  void restart();
+
+  std::uint64_t getVersion() const { return _version; }
+
+  private:
+  Module        _module;
+  std::uint64_t _version;
+};
+
+// Version of a module: changes with every edit, and is odd while a guarded write is in progress
+std::uint64_t getModuleVersion(Module module);
+
+} // End namespace gbl
+
+#include "private/gbl_concurrency_impl.hh"
+
+#endif
+
@@ -0,0 +1,65 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_DESIGN_HH
+#define GBL_DESIGN_HH
+
+#include "gbl.hh"
+
+#include <vector>
+
+namespace gbl {
+
+/************************************************************************
+ * Collection of modules owned together
+ *
+ * Modules in a design are numbered densely from 0, in order of addition.
+ * Removing a module gives its identifier to the last module.
+ *
+ * When the design is destroyed, the modules are released parents first,
+ * so that no module outlives the design while instanciating a released one
+ * unless it is referenced elsewhere.
+ ************************************************************************/
+
+class Design {
+  public:
+  Design();
+  ~Design();
+
+  Design(const Design&) = delete;
+  Design& operator=(const Design&) = delete;
+
+  // Creation of modules owned by the design
+  Module createHier();
+  Module createLeaf();
+  // Ownership of an existing module, which must not belong to a design yet
+  void add(Module module);
+  // Release a module; the last module takes its identifier
+  void remove(Module module);
+
+  Size getNumModules() const;
+  Module getModule(Size id) const;
+  bool contains(Module module) const;
+  // Dense identifier of a module in this design
+  Size getId(Module module) const;
+
+  // Renumber the ports of a module densely, in the same order, in the module and in all its instances
+  // All the modules instanciating it must belong to the design; returns the new index of each old port
+  std::vector<Size> compactPorts(Module module);
+
+  // Runs func(Module) on each module in parallel
+  template<class Func>
+  void parallelForEachModule(Func func) const;
+
+  private:
+  std::vector<Size> getTeardownOrder() const;
+
+  private:
+  std::vector<internal::ModuleImpl*> _modules;
+};
+
+} // End namespace gbl
+
+#include "private/gbl_design_impl.hh"
+
+#endif
+
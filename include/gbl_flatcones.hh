@@ -0,0 +1,79 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_FLATCONES_HH
+#define GBL_FLATCONES_HH
+
+#include "gbl_flatnets.hh"
+
+#include <vector>
+
+namespace gbl {
+
+/************************************************************************
+ * Fan-in and fan-out cones of the flat netlist
+ *
+ * The vertices are the occurrences of the leaf modules and the top
+ * module, identified by their flat node index. A net leads from the
+ * nodes driving it to the nodes reading it, depending on the direction
+ * of the pins: DIR_OUT ports of the leaves and DIR_IN ports of the top
+ * module drive the net, the others read it; pins without a direction or
+ * DIR_INOUT do both. Every input of a leaf reaches all its outputs.
+ *
+ * The top module is the boundary of the cones: they contain it, but the
+ * traversal doesn't continue through its ports unless it is a source.
+ *
+ * The connectivity is stored as compressed arrays, built from the flat
+ * nets. Traversals are level-synchronous and run in parallel; up to 64
+ * sources are traversed at once, one bit of a word each. Like the nets,
+ * the cones must not be used once the view is renumbered.
+ ************************************************************************/
+
+class FlatCones {
+  public:
+  enum Direction {
+    FanOut,
+    FanIn
+  };
+
+  FlatCones(const FlatView& view, const FlatNets& nets);
+
+  // Nodes reached from at least one of the sources, sorted
+  void getCone(const std::vector<FlatSize>& sources, Direction dir, std::vector<FlatSize>& out) const;
+  // Cone of each source, sorted; sources are traversed by batches of 64
+  void getCones(const std::vector<FlatSize>& sources, Direction dir, std::vector<std::vector<FlatSize> >& out) const;
+  // Bit i of out[node] is set if the node is reached from sources[i]; at most 64 sources
+  void propagate(const std::vector<FlatSize>& sources, Direction dir, std::vector<std::uint64_t>& out) const;
+
+  FlatSize getNumNodes() const { return _fanOut._nodeNetOffsets.size() - 1; }
+
+  // True if the view was renumbered since the cones were built (see FlatView::getEpoch)
+  bool isStale() const { return _epoch != _view.getEpoch(); }
+
+  private:
+  // Nodes of a net and nets of a node, in the direction of the traversal
+  struct Adjacency {
+    std::vector<FlatSize> _netNodeOffsets;
+    std::vector<FlatSize> _netNodes;
+    std::vector<FlatSize> _nodeNetOffsets;
+    std::vector<FlatSize> _nodeNets;
+  };
+  const Adjacency& getAdjacency(Direction dir) const { return dir == FanOut ? _fanOut : _fanIn; }
+  static void buildAdjacency(const FlatNets& nets, const std::vector<FlatSize>& pinNodes, const std::vector<std::uint8_t>& pinRoles,
+                             std::uint8_t fromRole, std::uint8_t toRole, FlatSize numNodes, Adjacency& adj);
+
+  // Traversal from each source with its bits
+  void traverse(const std::vector<FlatSize>& sources, const std::vector<std::uint64_t>& sourceBits, Direction dir, std::vector<std::uint64_t>& out) const;
+
+  private:
+  const FlatView& _view;
+  std::uint64_t   _epoch;
+  FlatSize        _topIndex;
+  // Fan-out: nets driven by a node, then nodes reading a net; fan-in is the opposite
+  Adjacency _fanOut;
+  Adjacency _fanIn;
+};
+
+} // End namespace gbl
+
+#endif
+
@@ -0,0 +1,63 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_FLATNETS_HH
+#define GBL_FLATNETS_HH
+
+#include "gbl_flatview.hh"
+
+#include <vector>
+
+namespace gbl {
+
+/************************************************************************
+ * Physical nets of a flat view
+ *
+ * A net is a set of flat wires joined through the ports of the
+ * instances. Nets are numbered densely, in the order of their smallest
+ * flat wire index.
+ *
+ * The pins of a net are the flat ports of the leaf modules and of the top
+ * module connected to it, identified by their flat port index and sorted.
+ * Both directions are stored as compressed arrays, for placement and
+ * routing tools.
+ *
+ * The nets are a snapshot: they are stale once the view is renumbered
+ * (see FlatView::getEpoch), and must not be accessed anymore.
+ ************************************************************************/
+
+class FlatNets {
+  public:
+  explicit FlatNets(const FlatView& view);
+
+  // True if the view was renumbered since the nets were computed
+  bool isStale() const { return _epoch != _view.getEpoch(); }
+
+  FlatSize getNumNets() const { assert(!isStale()); return _netPinOffsets.size() - 1; }
+
+  // Net of a flat wire
+  FlatSize getWireNet(FlatSize wireIndex) const { assert(!isStale()); return _wireNets[wireIndex]; }
+  // Net of a pin, or InvalidFlatIndex if the flat port is not a connected pin
+  FlatSize getPinNet(FlatSize portIndex) const { assert(!isStale()); return _pinNets[portIndex]; }
+  // Pins of a net, as a range in getNetPins()
+  FlatRange getPinRange(FlatSize net) const { assert(!isStale()); return FlatRange(_netPinOffsets[net], _netPinOffsets[net+1]); }
+
+  // Compressed arrays: the pins of net i are getNetPins()[getNetPinOffsets()[i] .. getNetPinOffsets()[i+1]]
+  const std::vector<FlatSize>& getNetPinOffsets() const { assert(!isStale()); return _netPinOffsets; }
+  const std::vector<FlatSize>& getNetPins() const { assert(!isStale()); return _netPins; }
+  // Indexed by flat wire and flat port index respectively
+  const std::vector<FlatSize>& getWireNets() const { assert(!isStale()); return _wireNets; }
+  const std::vector<FlatSize>& getPinNets() const { assert(!isStale()); return _pinNets; }
+
+  private:
+  const FlatView&       _view;
+  std::uint64_t         _epoch;
+  std::vector<FlatSize> _wireNets;
+  std::vector<FlatSize> _pinNets;
+  std::vector<FlatSize> _netPinOffsets;
+  std::vector<FlatSize> _netPins;
+};
+
+} // End namespace gbl
+
+#endif
+
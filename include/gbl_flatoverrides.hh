@@ -0,0 +1,77 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_FLATOVERRIDES_HH
+#define GBL_FLATOVERRIDES_HH
+
+#include "gbl_flatview.hh"
+
+#include <vector>
+
+namespace gbl {
+
+/************************************************************************
+ * Sparse per-occurrence data on top of a flat view
+ *
+ * Properties and attributes set here only apply to a single flat object,
+ * and take precedence over the data of the hierarchical object.
+ * Lookups fall back to the hierarchical data when there is no override.
+ * Overrides are keyed by flat index: they are stale once the view is renumbered
+ * after an edit (see FlatView::getEpoch), and must be cleared.
+ ************************************************************************/
+
+template<class FlatObject, class Object>
+class FlatOverrides {
+  public:
+  // Overrides for a single flat object
+  void setProperty(FlatObject obj, ID id, bool val);
+  void setAttribute(FlatObject obj, ID id, std::int64_t val);
+  bool eraseProperty(FlatObject obj, ID id);
+  bool eraseAttribute(FlatObject obj, ID id);
+
+  // Lookup with fallback to the hierarchical data
+  bool hasProperty(FlatObject obj, ID id) const;
+  bool hasAttribute(FlatObject obj, ID id) const;
+  std::int64_t getAttribute(FlatObject obj, ID id) const;
+
+  // Batched lookup for all occurrences of a hierarchical object, in flat index order (see FlatView::getFlatRange)
+  void getProperties(Object obj, ID id, std::vector<bool>& values) const;
+  void getAttributes(Object obj, ID id, std::int64_t defaultVal, std::vector<std::int64_t>& values) const;
+
+  FlatSize size() const;
+  void clear();
+
+  explicit FlatOverrides(const FlatView& view);
+
+  private:
+  struct Entry {
+    FlatSize     _index;
+    ID           _id;
+    bool         _isProp;
+    std::int64_t _val;
+
+    bool operator<(const Entry& o) const;
+  };
+
+  const Entry* find(FlatSize index, ID id, bool isProp) const;
+  void set(FlatSize index, ID id, bool isProp, std::int64_t val);
+  bool erase(FlatSize index, ID id, bool isProp);
+  Size getModIndex(FlatSize index) const;
+
+  private:
+  const FlatView& _view;
+  std::uint64_t   _epoch;
+  // Sorted overrides for the flat index range of each module
+  std::vector<std::vector<Entry> > _entries;
+  FlatSize _size;
+};
+
+typedef FlatOverrides<FlatNode, Node> FlatNodeOverrides;
+typedef FlatOverrides<FlatWire, Wire> FlatWireOverrides;
+typedef FlatOverrides<FlatPort, Port> FlatPortOverrides;
+
+} // End namespace gbl
+
+#include "private/gbl_flatoverrides_impl.hh"
+
+#endif
+
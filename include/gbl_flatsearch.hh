@@ -0,0 +1,73 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_FLATSEARCH_HH
+#define GBL_FLATSEARCH_HH
+
+#include "gbl_flatview.hh"
+#include "gbl_summaries.hh"
+
+#include <vector>
+
+namespace gbl {
+
+/************************************************************************
+ * Search of the flat objects by name or property
+ *
+ * Each module is summarized by the sets of the names and properties found
+ * on its objects (the module itself, its instances, wires and ports) and
+ * on the objects of the modules below it. The sets are exact, so that
+ * they don't saturate with the number of names; their size is the number
+ * of distinct symbols of the subtree. The search only descends into the
+ * instances whose module contains the symbol, so that subtrees without a
+ * match are skipped whole.
+ *
+ * The summaries are built on the first search, and kept up to date with
+ * the edits of the modules (see ModuleSummaries).
+ ************************************************************************/
+
+// Sorted identifiers, without duplicates
+class SymbolSet {
+  public:
+  // Takes the content of ids, in any order and with duplicates
+  void assign(std::vector<ID>& ids);
+  bool contains(ID id) const;
+
+  Size size() const { return _ids.size(); }
+  const std::vector<ID>& getIds() const { return _ids; }
+
+  private:
+  std::vector<ID> _ids;
+};
+
+struct SubtreeSymbols {
+  SymbolSet _names;
+  SymbolSet _properties;
+};
+
+class FlatSearch {
+  public:
+  explicit FlatSearch(const FlatView& view);
+
+  // Flat indexes of the matching objects, in traversal order
+  void findInstancesWithName(ID id, std::vector<FlatSize>& out);
+  void findInstancesWithProperty(ID id, std::vector<FlatSize>& out);
+  void findWiresWithName(ID id, std::vector<FlatSize>& out);
+  void findWiresWithProperty(ID id, std::vector<FlatSize>& out);
+
+  // Number of flat modules whose objects were examined by the last search
+  FlatSize getNumVisitedModules() const { return _numVisited; }
+
+  private:
+  void find(ID id, bool isName, bool wires, std::vector<FlatSize>& out);
+  void find(FlatModule module, ID id, bool isName, bool wires, std::vector<FlatSize>& out);
+
+  private:
+  const FlatView&                 _view;
+  ModuleSummaries<SubtreeSymbols> _summaries;
+  FlatSize                        _numVisited;
+};
+
+} // End namespace gbl
+
+#endif
+
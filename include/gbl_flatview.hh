@@ -10,6 +10,13 @@ namespace gbl {
 
 /************************************************************************
  * Flat view of the database
+ *
+ * Preconditions of the FlatView queries, checked by assertions only:
+ *    * Queries by hierarchical object (getFlatRange, getNumFlatInstanciations)
+ *      need an object of a module below the top module; use contains()
+ *      to test a module first
+ *    * Queries by flat index (getFlat*ByIndex) need an index below the
+ *      corresponding getNumFlat*() count
  ************************************************************************/
 
 class FlatWire {
@@ -25,6 +32,8 @@ class FlatWire {
 
   bool hasName(ID id);
   bool hasProperty(ID id);
+  bool hasAttribute(ID id);
+  std::int64_t getAttribute(ID id);
 
   Names names();
   Properties properties();
@@ -37,6 +46,7 @@ class FlatWire {
   Wire getObject();
   // Global index for the wire
   FlatSize getIndex();
+  FlatWireId getId();
 
   protected:
   Wire _object;
@@ -60,6 +70,8 @@ class FlatNode {
 
   bool hasName(ID id);
   bool hasProperty(ID id);
+  bool hasAttribute(ID id);
+  std::int64_t getAttribute(ID id);
 
   Names names();
   Properties properties();
@@ -72,6 +84,7 @@ class FlatNode {
   Node getObject();
   // Global index for the node; a FlatInstance and its corresponding FlatModule share the same
   FlatSize getIndex();
+  FlatNodeId getId();
 
   protected:
   Node _object;
@@ -134,6 +147,8 @@ class FlatPort {
 
   bool hasName(ID id);
   bool hasProperty(ID id);
+  bool hasAttribute(ID id);
+  std::int64_t getAttribute(ID id);
 
   Names names();
   Properties properties();
@@ -153,6 +168,7 @@ class FlatPort {
   Port getObject();
   // Global index for the port; a FlatInstancePort and its corresponding FlatModulePort share the same
   FlatSize getIndex();
+  FlatPortId getId();
 
   protected:
   Port _object;
@@ -178,6 +194,32 @@ class FlatModulePort : public FlatPort {
   FlatModulePort(const ModulePort&, const FlatRef&);
   ModulePort getObject();
 };
+
+/************************************************************************
+ * Compact handles to flat objects
+ *    * Only the global index is stored: 8 bytes, for large worklists and heaps
+ *    * Decoded on demand by the FlatView they were obtained from
+ ************************************************************************/
+
+template<class FlatObject>
+class FlatId {
+  public:
+  FlatSize getIndex() const;
+  bool isValid() const;
+
+  FlatId();
+  explicit FlatId(FlatSize index);
+
+  bool operator==(const FlatId&) const;
+  bool operator!=(const FlatId&) const;
+  bool operator< (const FlatId&) const;
+  bool operator> (const FlatId&) const;
+  bool operator<=(const FlatId&) const;
+  bool operator>=(const FlatId&) const;
+
+  private:
+  FlatSize _index;
+};
 } // End namespace gbl
 
 #include "private/gbl_flatview_impl.hh"
@@ -0,0 +1,72 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_HIERARCHY_HH
+#define GBL_HIERARCHY_HH
+
+#include "gbl.hh"
+
+#include <vector>
+#include <memory>
+
+namespace gbl {
+
+/************************************************************************
+ * Topological order of the modules below a top module
+ *
+ * The order is deterministic: modules are sorted by a depth-first
+ * traversal in instance order, and parents always come before the
+ * modules they instanciate. The index of a module in the order is a
+ * dense identifier for the hierarchy.
+ *
+ * A hierarchy with a cycle has no topological order: the order is then
+ * empty, and the cycle is reported instead.
+ *
+ * The order doesn't keep the modules alive.
+ ************************************************************************/
+
+class HierarchyOrder {
+  public:
+  // Shared order, computed again only if the instanciation graph changed since the last call
+  static std::shared_ptr<const HierarchyOrder> get(Module top);
+
+  explicit HierarchyOrder(Module top);
+
+  bool isAcyclic() const;
+  // Modules on the cycle found, each one instanciating the next
+  std::vector<Module> getCycle() const;
+
+  // Number of modules in the hierarchy, including the top module
+  Size size() const;
+  // Modules by index; 0 is the top module
+  Module getModule(Size index) const;
+  // InvalidIndex for modules outside the hierarchy
+  Size getIndex(Module module) const;
+  bool contains(Module module) const;
+  // Indexes of the modules instanciated by a module, in order of first instanciation
+  const std::vector<Size>& getChildren(Size index) const;
+
+  // The order is stale once instances or modules are created or destroyed
+  bool isUpToDate() const;
+
+  private:
+  friend class FlatView;
+
+  void compute();
+  Size getIndex(const internal::ModuleImpl* module) const;
+
+  private:
+  internal::ModuleImpl* _top;
+  std::vector<internal::ModuleImpl*> _mods;
+  // Indexed by module identifier
+  std::vector<Size> _id2Index;
+  std::vector<std::vector<Size> > _children;
+  std::vector<internal::ModuleImpl*> _cycle;
+  std::uint64_t _epoch;
+};
+
+} // End namespace gbl
+
+#include "private/gbl_hierarchy_impl.hh"
+
+#endif
+
@@ -0,0 +1,39 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_HMETIS_HH
+#define GBL_HMETIS_HH
+
+#include "gbl_flatnets.hh"
+
+#include <iosfwd>
+#include <vector>
+
+namespace gbl {
+
+/************************************************************************
+ * Exchange with hypergraph partitioners, in the hMETIS format
+ *
+ * The vertices are the occurrences of the leaf modules, numbered in flat
+ * index order; a leaf top module is not a vertex. The hyperedges are the
+ * nets connecting at least two of them; pins on top module ports are
+ * ignored.
+ *
+ * The hypergraph is streamed net by net from the flat nets, and is never
+ * built in memory.
+ ************************************************************************/
+
+void writeHMetis(std::ostream& out, const FlatView& view, const FlatNets& nets);
+// With the weight of each vertex taken from an attribute of the instance, or of the leaf module
+// if the instance doesn't have it (as in LeafCensus), or 1
+// Weights below 1 are written as 1, the smallest weight hMETIS accepts
+void writeHMetis(std::ostream& out, const FlatView& view, const FlatNets& nets, ID weightAttribute);
+
+// Reads the partition of each vertex, one per line as written by hMETIS
+// The result is indexed by flat node index, with InvalidIndex for the nodes that are not leaf occurrences
+// Returns false if the file doesn't have exactly one partition per vertex
+bool readHMetisPartition(std::istream& in, const FlatView& view, std::vector<Size>& parts);
+
+} // End namespace gbl
+
+#endif
+
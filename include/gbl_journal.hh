@@ -0,0 +1,134 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_JOURNAL_HH
+#define GBL_JOURNAL_HH
+
+#include "gbl.hh"
+
+#include <vector>
+
+namespace gbl {
+
+/************************************************************************
+ * Deferred edits of a module
+ *
+ * A journal records creations, connections and destructions without
+ * modifying the module, so that several threads can prepare edits of the
+ * same module at once. The journals are then merged into the netlist in
+ * the order of the vector, whatever the order they were recorded in.
+ *
+ * A journal that touches a wire or an instance already touched by an
+ * earlier journal of the merge is rejected as a whole. Touching a wire
+ * means connecting to it, disconnecting from it or destroying it, or
+ * destroying an instance connected to it.
+ *
+ * The netlist must not be modified between recording and merging.
+ ************************************************************************/
+
+class EditJournal;
+
+// Wire that may be created by a journal
+class JournalWire {
+  public:
+  JournalWire(Wire wire);
+  bool isNew() const;
+
+  private:
+  friend EditJournal;
+  JournalWire(Size ind, bool isNew);
+
+  private:
+  Size _ind;
+  bool _isNew;
+};
+
+// Instance that may be created by a journal; the module itself for module ports
+class JournalNode {
+  public:
+  JournalNode(Node node);
+  bool isNew() const;
+
+  private:
+  friend EditJournal;
+  JournalNode(Size ind, bool isNew);
+
+  private:
+  Size _ind;
+  bool _isNew;
+};
+
+class EditJournal {
+  public:
+  explicit EditJournal(Module module);
+
+  // Recording
+  JournalWire createWire();
+  JournalNode createInstance(Module downModule);
+  void connect(JournalNode node, Size portInd, JournalWire wire);
+  void connect(Port port, JournalWire wire);
+  void disconnect(Port port);
+  void destroy(JournalNode instance);
+  void destroy(JournalWire wire);
+
+  Size size() const;
+
+  // Apply the journals in order, rejecting those that conflict with an earlier one
+  static void merge(std::vector<EditJournal>& journals);
+
+  bool isMerged() const;
+  bool isRejected() const;
+
+  // Objects of a merged journal
+  Wire getWire(JournalWire wire) const;
+  Instance getInstance(JournalNode instance) const;
+
+  private:
+  enum OpType {
+    CreateWire,
+    CreateInstance,
+    Connect,
+    Disconnect,
+    DestroyInstance,
+    DestroyWire
+  };
+  struct Op {
+    OpType                _type;
+    JournalNode           _node;
+    JournalWire           _wire;
+    Size                  _portInd;
+    Module                _downModule;
+
+    Op(OpType type, JournalNode node, JournalWire wire, Size portInd=0, Module downModule=Module())
+    : _type(type), _node(node), _wire(wire), _portInd(portInd), _downModule(downModule) {}
+  };
+  enum Status {
+    Pending,
+    Merged,
+    Rejected
+  };
+
+  void touch(Wire wire);
+  void touch(Node node);
+  void apply();
+  Size getWireIndex(JournalWire wire) const;
+  Size getNodeIndex(JournalNode node) const;
+
+  private:
+  Module            _module;
+  std::vector<Op>   _ops;
+  Size              _numNewWires;
+  Size              _numNewNodes;
+  // Existing objects whose connections are modified, for conflict detection
+  std::vector<Size> _touchedWires;
+  std::vector<Size> _touchedNodes;
+
+  Status            _status;
+  // Indexes of the created objects after the merge
+  std::vector<Size> _newWires;
+  std::vector<Size> _newNodes;
+};
+
+} // End namespace gbl
+
+#endif
+
@@ -0,0 +1,79 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_SUMMARIES_HH
+#define GBL_SUMMARIES_HH
+
+#include "gbl_hierarchy.hh"
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+
+namespace gbl {
+
+/************************************************************************
+ * Bottom-up analyses of the hierarchy, memoized per module
+ *
+ * The summary of a module is computed by a user function from the module
+ * and the summaries of the modules it instanciates, which it obtains with
+ * getChild(). Compositional analyses (cell counts, area, depth, port to
+ * port connectivity) then cost a single evaluation per module rather than
+ * one per flat occurrence.
+ *
+ * Modules are evaluated children first, and independent modules in
+ * parallel: the function may be called from several threads at once, and
+ * must only read the module and the summaries of its children.
+ *
+ * Summaries are kept between calls, and computed again when the module or
+ * a module below it was edited since (see getModuleVersion). The cache
+ * keeps the modules it has a summary for alive until it is cleared.
+ ************************************************************************/
+
+template<class T>
+class ModuleSummaries {
+  public:
+  typedef std::function<T(Module module, const ModuleSummaries<T>& summaries)> Function;
+
+  explicit ModuleSummaries(Function func);
+
+  // Summary of a module, after updating the stale summaries below it; null if the hierarchy has a cycle
+  const T* get(Module module);
+  // Summary of a module instanciated by the module being evaluated
+  const T& getChild(Module child) const;
+
+  // Number of evaluations of the function so far
+  std::uint64_t getNumEvaluations() const;
+  void clear();
+
+  ModuleSummaries(const ModuleSummaries&) = delete;
+  ModuleSummaries& operator=(const ModuleSummaries&) = delete;
+
+  private:
+  struct Entry {
+    Module        _module;
+    // Version of the module for this summary
+    std::uint64_t _version;
+    // Order of the evaluation: the summary is stale if a child was evaluated after it
+    std::uint64_t _stamp;
+    T             _value;
+
+    Entry(Module module, std::uint64_t version, std::uint64_t stamp, T&& value);
+  };
+
+  bool isUpToDate(const HierarchyOrder& order, Size index) const;
+  void evaluate(const HierarchyOrder& order, Size index);
+
+  private:
+  Function _func;
+  // Indexed by module identifier
+  std::vector<std::unique_ptr<Entry> > _entries;
+  std::atomic<std::uint64_t> _numEvaluations;
+};
+
+} // End namespace gbl
+
+#include "private/gbl_summaries_impl.hh"
+
+#endif
+
@@ -23,6 +23,8 @@ struct Attribute {
   ID       _id;
   AttrType _type;
   AttrVal  _val;
+
+  static Attribute makeInt64(ID id, std::int64_t val);
 };
 
 struct DataImpl {
@@ -37,6 +39,7 @@ struct DataImpl {
   bool addName(ID name);
   bool addProp(ID prop);
   bool addAttr(Attribute attr);
+  bool setAttr(Attribute attr);
 
   bool eraseName(ID name);
   bool eraseProp(ID prop);
@@ -52,6 +55,14 @@ struct DataImpl {
   void clear();
 };
 
+inline Attribute Attribute::makeInt64(ID id, std::int64_t val) {
+  Attribute ret;
+  ret._id = id;
+  ret._type = Int64;
+  ret._val._int64 = val;
+  return ret;
+}
+
 inline bool DataImpl::hasName(ID name) const {
   for(ID id : _names){
     if (id == name) return true;
@@ -106,6 +117,16 @@ inline bool DataImpl::addAttr(Attribute attr) {
     return true;
   }
 }
+inline bool DataImpl::setAttr(Attribute attr) {
+  for(Attribute& a : _attrs){
+    if (a._id == attr._id) {
+      a = attr;
+      return false;
+    }
+  }
+  _attrs.push_back(attr);
+  return true;
+}
 inline bool DataImpl::eraseName(ID name) {
   for(Size i=0; i<_names.size(); ++i){
     if(_names[i] == name) {
@@ -0,0 +1,109 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_ALGORITHMS_IMPL_HH
+#define GBL_ALGORITHMS_IMPL_HH
+
+#include "gbl_parallel.hh"
+
+#include <vector>
+
+namespace gbl {
+
+namespace internal {
+// Position of an iterator in the underlying storage
+inline Size getStorageIndex(const EltRefInputIterator& it) { return it._ind; }
+inline Size getStorageIndex(const PortRefInputIterator& it) { return it._portInd; }
+template<class It, class P>
+inline Size getStorageIndex(const FilterIterator<It, P>& it) { return getStorageIndex(it.base()); }
+template<class It, class F>
+inline Size getStorageIndex(const TransformIterator<It, F>& it) { return getStorageIndex(it.base()); }
+
+// Iterator of the same type, at the first valid object of [ind, endInd)
+inline EltRefInputIterator getSubrangeIterator(EltRefInputIterator it, Size ind, Size) {
+    it._ind = ind;
+    return it;
+}
+inline PortRefInputIterator getSubrangeIterator(PortRefInputIterator it, Size ind, Size) {
+    it._portInd = ind;
+    return it;
+}
+template<class It, class P>
+inline FilterIterator<It, P> getSubrangeIterator(const FilterIterator<It, P>& it, Size ind, Size endInd) {
+    return FilterIterator<It, P>(
+        getSubrangeIterator(it.base(), ind, endInd),
+        getSubrangeIterator(it.base(), endInd, endInd),
+        it.predicate()
+    );
+}
+template<class It, class F>
+inline TransformIterator<It, F> getSubrangeIterator(const TransformIterator<It, F>& it, Size ind, Size endInd) {
+    return TransformIterator<It, F>(getSubrangeIterator(it.base(), ind, endInd), it.functor());
+}
+
+// Occupancy of the underlying pool, if any
+inline const std::vector<Size>* getStorageOccupancy(const EltRefInputIterator&) { return nullptr; }
+inline const std::vector<Size>* getStorageOccupancy(const PortRefInputIterator&) { return nullptr; }
+inline const std::vector<Size>* getStorageOccupancy(const FilterIterator<EltRefInputIterator, WireFilter>& it) {
+    return &it.base()._ptr->_wires.blockUsed();
+}
+inline const std::vector<Size>* getStorageOccupancy(const FilterIterator<EltRefInputIterator, NodeFilter>& it) {
+    return &it.base()._ptr->_nodes.blockUsed();
+}
+template<class It, class P>
+inline const std::vector<Size>* getStorageOccupancy(const FilterIterator<It, P>& it) { return getStorageOccupancy(it.base()); }
+template<class It, class F>
+inline const std::vector<Size>* getStorageOccupancy(const TransformIterator<It, F>& it) { return getStorageOccupancy(it.base()); }
+
+// Bounds of the chunks of [begin, end), with about the same number of objects in each
+inline void getBalancedChunks(Size begin, Size end, const std::vector<Size>* occupancy, std::vector<Size>& bounds) {
+    const Size blockSize = Pool<WireImpl>::BlockSize;
+    bounds.assign(1, begin);
+    if (occupancy == nullptr) {
+        Size grain = getDefaultGrain(end - begin);
+        for (Size b=begin+grain; b<end; b+=grain) {
+            bounds.push_back(b);
+        }
+    }
+    else {
+        // Cut on block boundaries, once the target number of objects is reached
+        Size total = 0;
+        for (Size block = begin / blockSize; block * blockSize < end && block < occupancy->size(); ++block) {
+            total += (*occupancy)[block];
+        }
+        Size target = getDefaultGrain(total);
+        Size count = 0;
+        for (Size block = begin / blockSize; block * blockSize < end && block < occupancy->size(); ++block) {
+            count += (*occupancy)[block];
+            Size blockEnd = (block + 1) * blockSize;
+            if (count >= target && blockEnd < end) {
+                bounds.push_back(blockEnd);
+                count = 0;
+            }
+        }
+    }
+    bounds.push_back(end);
+}
+} // End namespace gbl::internal
+
+template<class Iterator, class Func>
+inline void parallelForEach(const Container<Iterator>& objects, Func func) {
+    Size begin = internal::getStorageIndex(objects.begin());
+    Size end = internal::getStorageIndex(objects.end());
+    if (end <= begin) {
+        return;
+    }
+    std::vector<Size> bounds;
+    internal::getBalancedChunks(begin, end, internal::getStorageOccupancy(objects.begin()), bounds);
+    internal::parallelFor(0, bounds.size() - 1, 1, [&](Size chunk) {
+        Iterator it = internal::getSubrangeIterator(objects.begin(), bounds[chunk], bounds[chunk+1]);
+        Iterator chunkEnd = internal::getSubrangeIterator(objects.begin(), bounds[chunk+1], bounds[chunk+1]);
+        for (; it != chunkEnd; ++it) {
+            func(*it);
+        }
+    });
+}
+
+} // End namespace gbl
+
+#endif
+
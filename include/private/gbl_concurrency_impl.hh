@@ -0,0 +1,55 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_CONCURRENCY_IMPL_HH
+#define GBL_CONCURRENCY_IMPL_HH
+
+#include <thread>
+
+namespace gbl {
+
+inline std::uint64_t getModuleVersion(Module module) {
+    return module.ref()._ptr->_version.load(std::memory_order_acquire);
+}
+
+inline ModuleWriteGuard::ModuleWriteGuard(Module module)
+: _module(module)
+{
+    internal::ModuleImpl* impl = _module.ref()._ptr;
+    impl->_writeLock.lock();
+    impl->_version.fetch_add(1, std::memory_order_relaxed);
+    // The odd version is visible before any write of the section
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+inline ModuleWriteGuard::~ModuleWriteGuard() {
+    internal::ModuleImpl* impl = _module.ref()._ptr;
+    impl->_version.fetch_add(1, std::memory_order_release);
+    impl->_writeLock.unlock();
+}
+
+inline ModuleReadSection::ModuleReadSection(Module module)
+: _module(module)
+{
+    restart();
+}
+
+inline void ModuleReadSection::restart() {
+    while (true) {
+        _version = getModuleVersion(_module);
+        if ((_version & 1) == 0) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+inline bool ModuleReadSection::validate() const {
+    // The reads of the section happen before the version is read again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return _module.ref()._ptr->_version.load(std::memory_order_relaxed) == _version;
+}
+
+} // End namespace gbl
+
+#endif
+
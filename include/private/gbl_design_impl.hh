@@ -0,0 +1,39 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_DESIGN_IMPL_HH
+#define GBL_DESIGN_IMPL_HH
+
+#include "gbl_parallel.hh"
+
+namespace gbl {
+
+inline Size Design::getNumModules() const {
+    return _modules.size();
+}
+
+inline Module Design::getModule(Size id) const {
+    assert(id < _modules.size());
+    return Module(_modules[id]);
+}
+
+inline bool Design::contains(Module module) const {
+    return module.ref()._ptr->_design == this;
+}
+
+inline Size Design::getId(Module module) const {
+    assert(contains(module));
+    return module.ref()._ptr->_designId;
+}
+
+template<class Func>
+inline void Design::parallelForEachModule(Func func) const {
+    // Modules have very different sizes: one task each, balanced by work stealing
+    internal::parallelFor(0, _modules.size(), 1, [&](Size id) {
+        func(Module(_modules[id]));
+    });
+}
+
+} // End namespace gbl
+
+#endif
+
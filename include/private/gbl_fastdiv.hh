@@ -0,0 +1,83 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_FASTDIV_HH
+#define GBL_FASTDIV_HH
+
+#include "gbl_forward_declarations.hh"
+
+#include <cassert>
+
+namespace gbl {
+namespace internal {
+
+/************************************************************************
+ * Division by a runtime-invariant 64-bit integer
+ *    * Precomputed multiply-shift reciprocal (Granlund-Montgomery)
+ *    * Magic numbers that need 65 bits use an additional add and shift
+ ************************************************************************/
+
+class Divider {
+  public:
+  Divider(std::uint64_t d=1);
+
+  std::uint64_t divide(std::uint64_t n) const;
+  std::uint64_t divisor() const { return _divisor; }
+
+  private:
+  static std::uint64_t mulhi(std::uint64_t a, std::uint64_t b);
+
+  private:
+  std::uint64_t _divisor;
+  // Zero for powers of two
+  std::uint64_t _magic;
+  std::uint8_t  _shift;
+  bool          _add;
+};
+
+inline std::uint64_t Divider::mulhi(std::uint64_t a, std::uint64_t b) {
+  return static_cast<std::uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+}
+
+inline Divider::Divider(std::uint64_t d)
+: _divisor(d)
+, _magic(0)
+, _shift(0)
+, _add(false)
+{
+  assert(d != 0);
+  std::uint8_t floorLog2 = 63 - __builtin_clzll(d);
+  _shift = floorLog2;
+  if ((d & (d-1)) == 0) {
+    return;
+  }
+  unsigned __int128 num = static_cast<unsigned __int128>(1) << (64 + floorLog2);
+  std::uint64_t proposed = static_cast<std::uint64_t>(num / d);
+  std::uint64_t rem = static_cast<std::uint64_t>(num % d);
+  if (d - rem >= (std::uint64_t(1) << floorLog2)) {
+    // 2^floorLog2 is not enough: use a 65-bit magic number
+    proposed += proposed;
+    std::uint64_t twiceRem = rem + rem;
+    if (twiceRem >= d || twiceRem < rem) {
+      proposed += 1;
+    }
+    _add = true;
+  }
+  _magic = proposed + 1;
+}
+
+inline std::uint64_t Divider::divide(std::uint64_t n) const {
+  if (_magic == 0) {
+    return n >> _shift;
+  }
+  std::uint64_t q = mulhi(_magic, n);
+  if (_add) {
+    return (((n - q) >> 1) + q) >> _shift;
+  }
+  return q >> _shift;
+}
+
+} // End namespace gbl::internal
+} // End namespace gbl
+
+#endif
+
@@ -0,0 +1,161 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_FLATOVERRIDES_IMPL_HH
+#define GBL_FLATOVERRIDES_IMPL_HH
+
+#include <algorithm>
+
+namespace gbl {
+
+namespace internal {
+// Module owning a flat index, depending on the kind of flat object
+class FlatOverridesHelper {
+    public:
+    static Size getModIndex(const FlatView& v, FlatSize index, const FlatNode*) { return v.getModIndex(index); }
+    static Size getModIndex(const FlatView& v, FlatSize index, const FlatWire*) { return v.getWireModIndex(index); }
+    static Size getModIndex(const FlatView& v, FlatSize index, const FlatPort*) { return v.getPortModIndex(index); }
+
+    static Size getNumModules(const FlatView& v) { return v._mods.size(); }
+};
+} // End namespace gbl::internal
+
+template<class FlatObject, class Object>
+inline bool FlatOverrides<FlatObject, Object>::Entry::operator<(const Entry& o) const {
+    if (_index != o._index) return _index < o._index;
+    if (_isProp != o._isProp) return _isProp;
+    return _id < o._id;
+}
+
+template<class FlatObject, class Object>
+inline FlatOverrides<FlatObject, Object>::FlatOverrides(const FlatView& view)
+: _view(view)
+, _epoch(view.getEpoch())
+, _entries(internal::FlatOverridesHelper::getNumModules(view))
+, _size(0)
+{
+}
+
+template<class FlatObject, class Object>
+inline Size FlatOverrides<FlatObject, Object>::getModIndex(FlatSize index) const {
+    assert(_epoch == _view.getEpoch());
+    return internal::FlatOverridesHelper::getModIndex(_view, index, static_cast<const FlatObject*>(nullptr));
+}
+
+template<class FlatObject, class Object>
+inline const typename FlatOverrides<FlatObject, Object>::Entry*
+FlatOverrides<FlatObject, Object>::find(FlatSize index, ID id, bool isProp) const {
+    const std::vector<Entry>& entries = _entries[getModIndex(index)];
+    if (entries.empty()) return nullptr;
+    Entry key = {index, id, isProp, 0};
+    auto it = std::lower_bound(entries.begin(), entries.end(), key);
+    if (it == entries.end() || it->_index != index || it->_id != id || it->_isProp != isProp) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+template<class FlatObject, class Object>
+inline void FlatOverrides<FlatObject, Object>::set(FlatSize index, ID id, bool isProp, std::int64_t val) {
+    std::vector<Entry>& entries = _entries[getModIndex(index)];
+    Entry key = {index, id, isProp, val};
+    auto it = std::lower_bound(entries.begin(), entries.end(), key);
+    if (it != entries.end() && it->_index == index && it->_id == id && it->_isProp == isProp) {
+        it->_val = val;
+    }
+    else {
+        entries.insert(it, key);
+        ++_size;
+    }
+}
+
+template<class FlatObject, class Object>
+inline bool FlatOverrides<FlatObject, Object>::erase(FlatSize index, ID id, bool isProp) {
+    std::vector<Entry>& entries = _entries[getModIndex(index)];
+    Entry key = {index, id, isProp, 0};
+    auto it = std::lower_bound(entries.begin(), entries.end(), key);
+    if (it == entries.end() || it->_index != index || it->_id != id || it->_isProp != isProp) {
+        return false;
+    }
+    entries.erase(it);
+    --_size;
+    return true;
+}
+
+template<class FlatObject, class Object>
+inline void FlatOverrides<FlatObject, Object>::setProperty(FlatObject obj, ID id, bool val) {
+    set(obj.getIndex(), id, true, val ? 1 : 0);
+}
+template<class FlatObject, class Object>
+inline void FlatOverrides<FlatObject, Object>::setAttribute(FlatObject obj, ID id, std::int64_t val) {
+    set(obj.getIndex(), id, false, val);
+}
+template<class FlatObject, class Object>
+inline bool FlatOverrides<FlatObject, Object>::eraseProperty(FlatObject obj, ID id) {
+    return erase(obj.getIndex(), id, true);
+}
+template<class FlatObject, class Object>
+inline bool FlatOverrides<FlatObject, Object>::eraseAttribute(FlatObject obj, ID id) {
+    return erase(obj.getIndex(), id, false);
+}
+
+template<class FlatObject, class Object>
+inline bool FlatOverrides<FlatObject, Object>::hasProperty(FlatObject obj, ID id) const {
+    const Entry* entry = find(obj.getIndex(), id, true);
+    if (entry != nullptr) return entry->_val != 0;
+    return obj.hasProperty(id);
+}
+template<class FlatObject, class Object>
+inline bool FlatOverrides<FlatObject, Object>::hasAttribute(FlatObject obj, ID id) const {
+    return find(obj.getIndex(), id, false) != nullptr || obj.hasAttribute(id);
+}
+template<class FlatObject, class Object>
+inline std::int64_t FlatOverrides<FlatObject, Object>::getAttribute(FlatObject obj, ID id) const {
+    const Entry* entry = find(obj.getIndex(), id, false);
+    if (entry != nullptr) return entry->_val;
+    return obj.getAttribute(id);
+}
+
+template<class FlatObject, class Object>
+inline void FlatOverrides<FlatObject, Object>::getProperties(Object obj, ID id, std::vector<bool>& values) const {
+    FlatRange range = _view.getFlatRange(obj);
+    // The hierarchical value is shared by all occurrences: only the overrides need to be merged
+    values.assign(range.second - range.first, obj.hasProperty(id));
+    const std::vector<Entry>& entries = _entries[getModIndex(range.first)];
+    // Smallest entry for the first index: properties sort before attributes
+    Entry key = {range.first, 0, true, 0};
+    for (auto it = std::lower_bound(entries.begin(), entries.end(), key); it != entries.end() && it->_index < range.second; ++it) {
+        if (it->_isProp && it->_id == id) {
+            values[it->_index - range.first] = it->_val != 0;
+        }
+    }
+}
+
+template<class FlatObject, class Object>
+inline void FlatOverrides<FlatObject, Object>::getAttributes(Object obj, ID id, std::int64_t defaultVal, std::vector<std::int64_t>& values) const {
+    FlatRange range = _view.getFlatRange(obj);
+    values.assign(range.second - range.first, obj.hasAttribute(id) ? obj.getAttribute(id) : defaultVal);
+    const std::vector<Entry>& entries = _entries[getModIndex(range.first)];
+    Entry key = {range.first, 0, true, 0};
+    for (auto it = std::lower_bound(entries.begin(), entries.end(), key); it != entries.end() && it->_index < range.second; ++it) {
+        if (!it->_isProp && it->_id == id) {
+            values[it->_index - range.first] = it->_val;
+        }
+    }
+}
+
+template<class FlatObject, class Object>
+inline FlatSize FlatOverrides<FlatObject, Object>::size() const {
+    return _size;
+}
+
+template<class FlatObject, class Object>
+inline void FlatOverrides<FlatObject, Object>::clear() {
+    _epoch = _view.getEpoch();
+    _entries.assign(internal::FlatOverridesHelper::getNumModules(_view), std::vector<Entry>());
+    _size = 0;
+}
+
+} // End namespace gbl
+
+#endif
+
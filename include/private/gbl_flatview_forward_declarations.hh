@@ -5,6 +5,8 @@
 
 #include "private/gbl_forward_declarations.hh"
 
+#include <utility>
+
 namespace gbl {
 
 class FlatModule;
@@ -16,8 +18,18 @@ class FlatInstancePort;
 class FlatModulePort;
 class FlatView;
 
+template<class FlatObject, class Object> class FlatOverrides;
+
+template<class FlatObject> class FlatId;
+typedef FlatId<FlatNode> FlatNodeId;
+typedef FlatId<FlatWire> FlatWireId;
+typedef FlatId<FlatPort> FlatPortId;
+
 namespace internal {
 class FlatTransform;
+class FlatOverridesHelper;
+
+template<class Id> class FlatIdIterator;
 
 typedef TransformIterator<WireIterator,         FlatTransform> FlatWireIterator;
 typedef TransformIterator<NodeIterator,         FlatTransform> FlatNodeIterator;
@@ -28,6 +40,22 @@ typedef TransformIterator<InstancePortIterator, FlatTransform> FlatInstancePortI
 typedef TransformIterator<ModulePortIterator,   FlatTransform> FlatModulePortIterator;
 }
 
+typedef Container<internal::FlatIdIterator<FlatNodeId> > FlatNodeIds;
+typedef Container<internal::FlatIdIterator<FlatWireId> > FlatWireIds;
+typedef Container<internal::FlatIdIterator<FlatPortId> > FlatPortIds;
+
+// Half-open interval of flat indexes
+typedef std::pair<FlatSize, FlatSize> FlatRange;
+
+// Flat index decoded into its hierarchical object and the occurrence of its parent module
+struct DecodedFlatIndex {
+  internal::ModuleImpl *_ptr;
+  // Wire or port index in the module
+  Size _ind;
+  // Same as the FlatRef index
+  FlatSize _occurrence;
+};
+
 struct FlatRef {
   bool operator==(const FlatRef&) const;
   bool operator!=(const FlatRef&) const;
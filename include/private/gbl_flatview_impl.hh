@@ -3,21 +3,68 @@
 #ifndef GBL_FLATVIEW_IMPL_HH
 #define GBL_FLATVIEW_IMPL_HH
 
+#include "gbl_fastdiv.hh"
+
 #include <vector>
-#include <unordered_map>
 #include <algorithm>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <memory>
 
 namespace gbl {
 
+namespace internal {
+// Finds the interval containing a flat index
+// A table on the high bits of the index narrows the search to a few intervals, instead of a bisection over all of them
+class RangeLookup {
+    public:
+    void init(const std::vector<FlatSize>& endIndexs);
+    Size find(const std::vector<FlatSize>& endIndexs, FlatSize index) const;
+
+    RangeLookup() : _shift(0) {}
+
+    private:
+    // Interval containing the first index of each bucket, with a sentinel at the end
+    std::vector<Size> _buckets;
+    unsigned _shift;
+};
+} // End namespace gbl::internal
+
 /*
  * Internal datastructure for flat netlist view
+ *
+ * The view follows the edits of the modules in its hierarchy: only the tables of the edited modules are rebuilt,
+ * and the flat indexes are renumbered on the next query.
+ * Instance edits that keep the module order only renumber the occurrences of the modules whose parents changed:
+ * creating or destroying a module, a cycle or a new module in the hierarchy rebuild the whole numbering.
+ *
+ * A lazy view only computes the module ordering and the flat counts at construction time.
+ * The wire and port tables of a module are built on the first query that needs them.
  */
-class FlatView {
+class FlatView : private internal::ModuleObserver {
 public:
-    FlatView(Module topModule);
+    FlatView(Module topModule, bool lazy=false);
+    ~FlatView();
+
+    FlatView(const FlatView&) = delete;
+    FlatView& operator=(const FlatView&) = delete;
 
     void selfcheck() const;
 
+    // Incremented each time the flat indexes are renumbered: flat indexes and objects obtained before are stale
+    std::uint64_t getEpoch() const;
+    // Apply the pending edits now rather than on the next query
+    void update();
+
+    // True if the hierarchy below the top module has a cycle: the view is then empty until the cycle is broken
+    bool hasCycle() const;
+
+    // Number of modules whose wire and port tables have been built
+    Size getNumMaterializedModules() const;
+    // Number of modules whose parent instances were renumbered by the last update
+    Size getNumRenumberedModules() const;
+
     FlatSize getNumFlatModules() const;
     FlatSize getNumFlatWires() const;
     FlatSize getNumFlatPorts() const;
@@ -26,6 +73,8 @@ public:
     FlatSize getNumFlatInstanciations(Wire wire) const;
 
     FlatModule getTop() const;
+    // Whether the module is in the hierarchy below the top module
+    bool contains(Module module) const;
 
     FlatModule       getFlatModuleByIndex       (FlatSize index) const;
     FlatInstance     getFlatInstanceByIndex     (FlatSize index) const;
@@ -33,19 +82,45 @@ public:
     FlatModulePort   getFlatModulePortByIndex   (FlatSize index) const;
     FlatInstancePort getFlatInstancePortByIndex (FlatSize index) const;
 
+    // Decoding of compact handles
+    FlatModule       getFlatModule       (FlatNodeId id) const;
+    FlatInstance     getFlatInstance     (FlatNodeId id) const;
+    FlatWire         getFlatWire         (FlatWireId id) const;
+    FlatModulePort   getFlatModulePort   (FlatPortId id) const;
+    FlatInstancePort getFlatInstancePort (FlatPortId id) const;
+
+    // All compact handles, in index order
+    FlatNodeIds nodeIds() const;
+    FlatWireIds wireIds() const;
+    FlatPortIds portIds() const;
+
+    // Contiguous flat indexes of all the occurrences of a hierarchical object
+    FlatRange getFlatRange(Node node) const;
+    FlatRange getFlatRange(Wire wire) const;
+    FlatRange getFlatRange(Port port) const;
+
+    // Batched decoding of flat indexes, sorted or not
+    void decodeWireIndexes (const FlatSize* begin, const FlatSize* end, DecodedFlatIndex* out) const;
+    void decodePortIndexes (const FlatSize* begin, const FlatSize* end, DecodedFlatIndex* out) const;
+    void decodeWireIndexes (const std::vector<FlatSize>& indexes, std::vector<DecodedFlatIndex>& out) const;
+    void decodePortIndexes (const std::vector<FlatSize>& indexes, std::vector<DecodedFlatIndex>& out) const;
+
 private:
     struct DownInfo {
         // Offset between child and parent flat indexing (local indexing, not the global contiguous one)
         FlatSize _offset;
+        // Index of the instanciated module, so that navigation doesn't need to look it up
+        Size     _downModIndex;
 
-        DownInfo(FlatSize offs) : _offset(offs) {}
+        DownInfo(FlatSize offs, Size downModIndex) : _offset(offs), _downModIndex(downModIndex) {}
     };
     struct UpInfo {
         // Offset between child and parent flat indexing (local indexing, not the global contiguous one)
         FlatSize _offset;
         Instance _parentInstance;
+        Size     _parentModIndex;
 
-        UpInfo(Instance inst, FlatSize offs) : _offset(offs), _parentInstance(inst) {}
+        UpInfo(Instance inst, Size parentModIndex, FlatSize offs) : _offset(offs), _parentInstance(inst), _parentModIndex(parentModIndex) {}
     };
     struct ParentInfos {
         // Interval for each parent instance 
@@ -56,47 +131,127 @@ private:
         // Offset for each instance in the module (possibly InvalidFlatIndex for holes)
         std::vector<DownInfo> _downInfos;
     };
+    struct ChildCount {
+        internal::ModuleImpl* _downModule;
+        // Number of instances of the module, and index of the first one
+        Size                  _count;
+        Size                  _first;
+
+        ChildCount(internal::ModuleImpl* downModule, Size count, Size first) : _downModule(downModule), _count(count), _first(first) {}
+    };
+    struct InstanceChange {
+        Size                  _modIndex;
+        Size                  _instIndex;
+        internal::ModuleImpl* _oldModule;
+        internal::ModuleImpl* _newModule;
+
+        InstanceChange(Size modIndex, Size instIndex, internal::ModuleImpl* oldModule, internal::ModuleImpl* newModule)
+        : _modIndex(modIndex), _instIndex(instIndex), _oldModule(oldModule), _newModule(newModule) {}
+    };
     friend FlatInstance;
     friend FlatModule;
     friend FlatNode;
     friend FlatWire;
     friend FlatPort;
+    friend FlatModulePort;
+    friend FlatInstancePort;
+    friend internal::FlatOverridesHelper;
 
 private:
     Size getModIndex(FlatSize flatIndex) const;
     Size getWireModIndex(FlatSize flatIndex) const;
     Size getPortModIndex(FlatSize flatIndex) const;
 
-    Size getModIndex(Module module) const;
+    Size getModIndex(const internal::ModuleImpl* module) const;
 
     FlatSize getNumFlatInstanciations(Size modIndex) const;
 
+    // Navigation helpers, for a module occurrence identified by its module index
+    const UpInfo& getUpInfo(Size modIndex, FlatSize localIndex) const;
+    FlatInstance getUpInstance(Size modIndex, FlatSize localIndex) const;
+
+    // Incremental maintenance
+    // The tables are derived from the netlist: they are mutable, and brought up to date by the const queries
+    void notifyEdit(internal::ModuleImpl* module, EditType edit, Size index) const override;
+    void sync() const;
+    void applyEdits() const;
+    void rebuildHierarchy() const;
+    void collectInstances(Size modIndex) const;
+    void patchInstances(Size modIndex, std::vector<InstanceChange>& changes) const;
+    void addChild(Size modIndex, internal::ModuleImpl* downModule, Size instIndex) const;
+    void removeChild(Size modIndex, internal::ModuleImpl* downModule, Size instIndex) const;
+    bool hasSameOrder() const;
+    void renumberHierarchy(const std::vector<InstanceChange>& changes) const;
+    void setDownInfo(Size modIndex, Size instIndex, DownInfo info) const;
+    void buildTables(Size modIndex) const;
+    void materialize(Size modIndex) const;
+    void materializeSlow(Size modIndex) const;
+    void invalidateTables(Size modIndex) const;
+    void buildHierarchy() const;
+    void buildEndIndexes() const;
+
+    void initLookups() const;
+    void selfcheck(Size modIndex) const;
+    void decodeIndexes(const std::vector<FlatSize>& endIndexs, const internal::RangeLookup& lookup, const std::vector<std::vector<Size> >& objects,
+                       const FlatSize* begin, const FlatSize* end, DecodedFlatIndex* out) const;
+
 private:
     Module _topMod;
 
+    // All the state below is derived from the netlist, and updated by the const queries (see sync())
+
     // Basic module <--> index range bookkeeping
-    std::vector<internal::ModuleImpl*>   _mods;
-    // From Module to FlatModule
-    std::unordered_map<internal::ModuleImpl*, Size> _mod2Index;
+    mutable std::vector<internal::ModuleImpl*> _mods;
+    // From Module to FlatModule, indexed by module identifier (InvalidIndex for modules outside the view)
+    mutable std::vector<Size> _id2Index;
 
     // Hierarchy bookkeeping
+    // Instanciated module of each node, indexed by node index (nullptr for holes), kept to renumber without visiting the unchanged modules
+    mutable std::vector<std::vector<internal::ModuleImpl*> > _instances;
+    // Distinct instanciated modules of each module, in order of first instanciation like HierarchyOrder
+    mutable std::vector<std::vector<ChildCount> > _childCounts;
     // Up instances
-    std::vector<ParentInfos> _parents;
+    mutable std::vector<ParentInfos> _parents;
     // Down instances
-    std::vector<ChildInfos>  _children;
+    mutable std::vector<ChildInfos>  _children;
 
     // Contiguous indexing for modules (_modEndIndexs[i] to _modEndIndexs[i+1])
-    std::vector<FlatSize> _modEndIndexs;
+    mutable std::vector<FlatSize> _modEndIndexs;
 
     // Contiguous indexing for wires
-    std::vector<FlatSize> _wireEndIndexs;
-    std::vector<std::vector<Size> > _wires;
-    std::vector<std::vector<Size> > _wireHierToInternal;
+    mutable std::vector<FlatSize> _wireEndIndexs;
+    mutable std::vector<std::vector<Size> > _wires;
+    mutable std::vector<std::vector<Size> > _wireHierToInternal;
 
     // Contiguous indexing for ports
-    std::vector<FlatSize> _portEndIndexs;
-    std::vector<std::vector<Size> > _ports;
-    std::vector<std::vector<Size> > _portHierToInternal;
+    mutable std::vector<FlatSize> _portEndIndexs;
+    mutable std::vector<std::vector<Size> > _ports;
+    mutable std::vector<std::vector<Size> > _portHierToInternal;
+
+    // Fast decoding of flat indexes
+    mutable internal::RangeLookup _modLookup;
+    mutable internal::RangeLookup _wireLookup;
+    mutable internal::RangeLookup _portLookup;
+    // Division by the number of flat instanciations of each module
+    mutable std::vector<internal::Divider> _numInstDividers;
+
+    // Tables of each module built on first use for lazy views
+    bool                                         _lazy;
+    mutable std::unique_ptr<std::atomic<bool>[]> _materialized;
+    mutable std::mutex                           _materializeLock;
+
+    // Pending edits, applied on the next query
+    mutable std::atomic<bool> _dirty;
+    mutable bool              _hierarchyDirty;
+    // The hierarchy has a cycle: the view is empty
+    mutable bool              _cyclic;
+    mutable std::vector<char> _instancesDirty;
+    // Instances created, destroyed or replaced in each module
+    mutable std::vector<std::vector<Size> > _editedInstances;
+    mutable std::vector<char> _tablesDirty;
+    mutable Size              _numRenumbered;
+    mutable std::uint64_t     _epoch;
+    mutable std::mutex        _updateLock;
 };
 
 namespace internal {
@@ -156,28 +311,81 @@ inline Size bisectIndex(const std::vector<FlatSize>& vec, FlatSize flatIndex) {
     return ind - 1;
 }
 
-inline Size FlatView::getModIndex(Module module) const {
-    return _mod2Index.at(module.ref()._ptr);
+inline void FlatView::sync() const {
+    // Edits are not concurrent with the queries, but queries may be: acquire pairs with the end of
+    // another query's update, so that the tables it rebuilt are visible
+    if (__builtin_expect(_dirty.load(std::memory_order_acquire), false)) {
+        applyEdits();
+    }
+}
+
+inline void FlatView::materialize(Size modIndex) const {
+    if (__builtin_expect(!_materialized[modIndex].load(std::memory_order_acquire), false)) {
+        materializeSlow(modIndex);
+    }
+}
+
+inline bool FlatView::hasCycle() const {
+    sync();
+    return _cyclic;
+}
+
+inline std::uint64_t FlatView::getEpoch() const {
+    sync();
+    return _epoch;
+}
+
+inline Size FlatView::getModIndex(const internal::ModuleImpl* module) const {
+    sync();
+    assert(module->_id < _id2Index.size());
+    Size modIndex = _id2Index[module->_id];
+    assert(modIndex < _mods.size() && _mods[modIndex] == module);
+    return modIndex;
+}
+
+inline bool FlatView::contains(Module module) const {
+    sync();
+    const internal::ModuleImpl* ptr = module.ref()._ptr;
+    if (ptr->_id >= _id2Index.size()) return false;
+    Size modIndex = _id2Index[ptr->_id];
+    return modIndex < _mods.size() && _mods[modIndex] == ptr;
+}
+
+inline Size internal::RangeLookup::find(const std::vector<FlatSize>& endIndexs, FlatSize index) const {
+    assert(index < endIndexs.back());
+    FlatSize bucket = index >> _shift;
+    Size lo = _buckets[bucket];
+    Size hi = _buckets[bucket+1];
+    if (hi - lo <= 8) {
+        while (endIndexs[lo+1] <= index) {
+            ++lo;
+        }
+        return lo;
+    }
+    return std::upper_bound(endIndexs.begin() + lo + 1, endIndexs.begin() + hi + 1, index) - endIndexs.begin() - 1;
 }
 
 inline Size FlatView::getModIndex(FlatSize flatIndex) const {
-    return bisectIndex(_modEndIndexs, flatIndex);
+    sync();
+    return _modLookup.find(_modEndIndexs, flatIndex);
 }
 inline Size FlatView::getWireModIndex(FlatSize flatIndex) const {
-    return bisectIndex(_wireEndIndexs, flatIndex);
+    sync();
+    return _wireLookup.find(_wireEndIndexs, flatIndex);
 }
 inline Size FlatView::getPortModIndex(FlatSize flatIndex) const {
-    return bisectIndex(_portEndIndexs, flatIndex);
+    sync();
+    return _portLookup.find(_portEndIndexs, flatIndex);
 }
 
 inline FlatSize FlatView::getNumFlatInstanciations(Size modIndex) const {
     return _modEndIndexs[modIndex+1] - _modEndIndexs[modIndex];
 }
 inline FlatSize FlatView::getNumFlatInstanciations(Node node) const {
-    return getNumFlatInstanciations(getModIndex(node.getParentModule()));
+    return getNumFlatInstanciations(getModIndex(node.ref()._ptr));
 }
 inline FlatSize FlatView::getNumFlatInstanciations(Wire wire) const {
-    return getNumFlatInstanciations(getModIndex(wire.getParentModule()));
+    return getNumFlatInstanciations(getModIndex(wire.ref()._ptr));
 }
 
 inline FlatModule FlatView::getTop() const {
@@ -201,7 +409,8 @@ inline ModulePort FlatModulePort::getObject() {
 }
 
 inline bool FlatModule::isTop() {
-    return operator==(_ref._view.getTop());
+    // The top module is never instanciated in its own hierarchy
+    return _object.ref()._ptr == _ref._view._mods.front();
 }
 
 inline FlatRef::FlatRef(FlatSize index, const FlatView& view) 
@@ -226,9 +435,9 @@ inline FlatInstance::FlatInstance(const FlatNode& node) : FlatNode(node) {}
 inline FlatModulePort::FlatModulePort(const FlatPort& port) : FlatPort(port) {}
 inline FlatInstancePort::FlatInstancePort(const FlatPort& port) : FlatPort(port) {}
 
-inline FlatModule FlatNode::getParentModule() { return FlatModule(getObject().getParentModule(), _ref); }
-inline FlatModule FlatWire::getParentModule() { return FlatModule(getObject().getParentModule(), _ref); }
-inline FlatModule FlatPort::getParentModule() { return FlatModule(getObject().getParentModule(), _ref); }
+inline FlatModule FlatNode::getParentModule() { return FlatModule(FlatNode(Node(_object.ref()._ptr, 0), _ref)); }
+inline FlatModule FlatWire::getParentModule() { return FlatModule(FlatNode(Node(_object.ref()._ptr, 0), _ref)); }
+inline FlatModule FlatPort::getParentModule() { return FlatModule(FlatNode(Node(_object.ref()._ptr, 0), _ref)); }
 
 inline bool FlatNode::isInstance() { return getObject().isInstance(); }
 inline bool FlatNode::isModule() { return getObject().isModule(); }
@@ -240,105 +449,199 @@ inline FlatWire FlatPort::getWire() { return FlatWire(getObject().getWire(), _re
 inline FlatNode FlatPort::getNode() { return FlatNode(getObject().getNode(), _ref); }
 inline FlatInstance FlatInstancePort::getInstance() { return FlatInstance(getNode()); }
 
+inline const FlatView::UpInfo& FlatView::getUpInfo(Size modIndex, FlatSize localIndex) const {
+    assert(modIndex != 0);
+    const ParentInfos& info = _parents[modIndex];
+    // Most modules have a single parent instance
+    Size index = info._upInfos.size() == 1 ? 0 : bisectIndex(info._instEndIndexs, localIndex);
+    const UpInfo& up = info._upInfos[index];
+    assert(up._offset <= localIndex);
+    return up;
+}
+
+inline FlatInstance FlatView::getUpInstance(Size modIndex, FlatSize localIndex) const {
+    const UpInfo& up = getUpInfo(modIndex, localIndex);
+    return FlatInstance(FlatNode(up._parentInstance, FlatRef(localIndex - up._offset, *this)));
+}
+
 inline FlatInstance FlatModule::getUpInstance() {
-    FlatView::ParentInfos info = _ref._view._parents[_ref._view.getModIndex(getObject())];
-    Size index = bisectIndex(info._instEndIndexs, _ref._index);
-    FlatView::UpInfo up = info._upInfos[index];
-    assert(up._offset <= _ref._index);
-    return FlatInstance(up._parentInstance, FlatRef(_ref._index - up._offset, _ref._view));
+    return _ref._view.getUpInstance(_ref._view.getModIndex(_object.ref()._ptr), _ref._index);
 }
 
 inline FlatModule FlatInstance::getDownModule() {
-    FlatView::DownInfo down = _ref._view._children[_ref._view.getModIndex(getObject().getParentModule())]._downInfos[_object.ref()._ind];
-    return FlatModule(getObject().getDownModule(), FlatRef(_ref._index + down._offset, _ref._view));
+    const FlatView& v = _ref._view;
+    EltRef ref = _object.ref();
+    const FlatView::DownInfo& down = v._children[v.getModIndex(ref._ptr)]._downInfos[ref._ind];
+    return FlatModule(FlatNode(
+        Node(ref._ptr->_nodes[ref._ind]._instanciation, 0),
+        FlatRef(_ref._index + down._offset, v)
+    ));
 }
 
 inline bool FlatModulePort::isTopPort() {
-    return FlatPort::getParentModule().isTop();
+    return _object.ref()._ptr == _ref._view._mods.front();
 }
 
 inline FlatInstancePort FlatModulePort::getUpPort() {
     assert(!isTopPort());
-    FlatInstance upInst = getParentModule().getUpInstance();
-    return FlatInstancePort(
-        getObject().getUpPort(upInst.getObject()),
-        upInst._ref
-    );
+    const FlatView& v = _ref._view;
+    PortRef ref = _object.ref();
+    const FlatView::UpInfo& up = v.getUpInfo(v.getModIndex(ref._ptr), _ref._index);
+    EltRef instRef = up._parentInstance.ref();
+    return FlatInstancePort(FlatPort(
+        Port(instRef._ptr, instRef._ind, ref._portInd),
+        FlatRef(_ref._index - up._offset, v)
+    ));
 }
 
 inline FlatModulePort FlatInstancePort::getDownPort() {
-    FlatModule downMod = getInstance().getDownModule();
-    return FlatModulePort(
-        getObject().getDownPort(),
-        downMod._ref
-    );
+    const FlatView& v = _ref._view;
+    PortRef ref = _object.ref();
+    const FlatView::DownInfo& down = v._children[v.getModIndex(ref._ptr)]._downInfos[ref._instInd];
+    return FlatModulePort(FlatPort(
+        Port(ref._ptr->_nodes[ref._instInd]._instanciation, 0, ref._portInd),
+        FlatRef(_ref._index + down._offset, v)
+    ));
 }
 
 inline FlatSize FlatNode::getIndex() {
-    FlatModule repr = isInstance() ? FlatInstance(*this).getDownModule() : FlatModule(*this);
-    return repr._ref._index + _ref._view._modEndIndexs[_ref._view.getModIndex(repr.getObject())];
+    const FlatView& v = _ref._view;
+    Size modInd = v.getModIndex(_object.ref()._ptr);
+    if (isModule()) {
+        return v._modEndIndexs[modInd] + _ref._index;
+    }
+    // Same index as the corresponding module
+    const FlatView::DownInfo& down = v._children[modInd]._downInfos[_object.ref()._ind];
+    return v._modEndIndexs[down._downModIndex] + _ref._index + down._offset;
 }
 inline FlatSize FlatWire::getIndex() {
-    Size modInd = _ref._view.getModIndex(getObject().getParentModule());
-    FlatSize numInst = _ref._view.getNumFlatInstanciations(modInd);
+    const FlatView& v = _ref._view;
+    Size modInd = v.getModIndex(_object.ref()._ptr);
+    FlatSize numInst = v.getNumFlatInstanciations(modInd);
     assert(_ref._index < numInst);
-    return _ref._view._wireEndIndexs[modInd] + numInst * _ref._view._wireHierToInternal[modInd][getObject().ref()._ind] + _ref._index;
+    v.materialize(modInd);
+    return v._wireEndIndexs[modInd] + numInst * v._wireHierToInternal[modInd][_object.ref()._ind] + _ref._index;
 }
 inline FlatSize FlatPort::getIndex() {
     const FlatView& v = _ref._view;
-    FlatModulePort repr = isInstancePort() ? FlatInstancePort(*this).getDownPort() : FlatModulePort(*this);
-    Size modInd = v.getModIndex(repr.getObject().getParentModule());
+    PortRef ref = _object.ref();
+    Size modInd = v.getModIndex(ref._ptr);
+    FlatSize localIndex = _ref._index;
+    if (ref._instInd != 0) {
+        // Same index as the corresponding module port
+        const FlatView::DownInfo& down = v._children[modInd]._downInfos[ref._instInd];
+        modInd = down._downModIndex;
+        localIndex += down._offset;
+    }
     FlatSize numInst = v.getNumFlatInstanciations(modInd);
-    assert(repr._ref._index < numInst);
-    return v._portEndIndexs[modInd] + numInst * v._portHierToInternal[modInd][repr.getObject().ref()._portInd] + repr._ref._index;
+    assert(localIndex < numInst);
+    v.materialize(modInd);
+    return v._portEndIndexs[modInd] + numInst * v._portHierToInternal[modInd][ref._portInd] + localIndex;
 }
 
 inline FlatModule FlatView::getFlatModuleByIndex(FlatSize index) const {
     Size modInd = getModIndex(index);
-    return FlatModule(Module(_mods[modInd]), FlatRef(index - _modEndIndexs[modInd], *this));
+    return FlatModule(FlatNode(Node(_mods[modInd], 0), FlatRef(index - _modEndIndexs[modInd], *this)));
 }
 inline FlatInstance FlatView::getFlatInstanceByIndex(FlatSize index) const {
-    return getFlatModuleByIndex(index).getUpInstance();
+    Size modInd = getModIndex(index);
+    return getUpInstance(modInd, index - _modEndIndexs[modInd]);
 }
 
 inline FlatWire FlatView::getFlatWireByIndex(FlatSize index) const {
     Size modInd = getWireModIndex(index);
     FlatSize num = getNumFlatInstanciations(modInd);
     FlatSize localIndex = index - _wireEndIndexs[modInd];
+    FlatSize internalIndex = _numInstDividers[modInd].divide(localIndex);
+    materialize(modInd);
     return FlatWire(
-        Wire(_mods[modInd], _wires[modInd][localIndex / num])
-      , FlatRef(localIndex % num, *this)
+        Wire(_mods[modInd], _wires[modInd][internalIndex])
+      , FlatRef(localIndex - internalIndex * num, *this)
     );
 }
 inline FlatModulePort FlatView::getFlatModulePortByIndex(FlatSize index) const {
     Size modInd = getPortModIndex(index);
     FlatSize num = getNumFlatInstanciations(modInd);
     FlatSize localIndex = index - _portEndIndexs[modInd];
-    return FlatModulePort(
-        ModulePort(Port(_mods[modInd], 0u, _ports[modInd][localIndex / num]))
-      , FlatRef(localIndex % num, *this)
-    );
+    FlatSize internalIndex = _numInstDividers[modInd].divide(localIndex);
+    materialize(modInd);
+    return FlatModulePort(FlatPort(
+        Port(_mods[modInd], 0u, _ports[modInd][internalIndex])
+      , FlatRef(localIndex - internalIndex * num, *this)
+    ));
 }
 inline FlatInstancePort FlatView::getFlatInstancePortByIndex(FlatSize index) const {
-    return getFlatModulePortByIndex(index).getUpPort();
+    Size modInd = getPortModIndex(index);
+    FlatSize num = getNumFlatInstanciations(modInd);
+    FlatSize localIndex = index - _portEndIndexs[modInd];
+    FlatSize internalIndex = _numInstDividers[modInd].divide(localIndex);
+    FlatSize occurrence = localIndex - internalIndex * num;
+    const UpInfo& up = getUpInfo(modInd, occurrence);
+    materialize(modInd);
+    EltRef instRef = up._parentInstance.ref();
+    return FlatInstancePort(FlatPort(
+        Port(instRef._ptr, instRef._ind, _ports[modInd][internalIndex])
+      , FlatRef(occurrence - up._offset, *this)
+    ));
 }
 
 inline FlatSize FlatView::getNumFlatModules() const {
+    sync();
     return _modEndIndexs.back() - _modEndIndexs.front();
 }
 inline FlatSize FlatView::getNumFlatWires() const {
+    sync();
     return _wireEndIndexs.back() - _wireEndIndexs.front();
 }
 inline FlatSize FlatView::getNumFlatPorts() const {
+    sync();
     return _portEndIndexs.back() - _portEndIndexs.front();
 }
 
+inline FlatRange FlatView::getFlatRange(Node node) const {
+    Size modInd = getModIndex(node.ref()._ptr);
+    if (node.isModule()) {
+        return FlatRange(_modEndIndexs[modInd], _modEndIndexs[modInd+1]);
+    }
+    const DownInfo& down = _children[modInd]._downInfos[node.ref()._ind];
+    FlatSize begin = _modEndIndexs[down._downModIndex] + down._offset;
+    return FlatRange(begin, begin + getNumFlatInstanciations(modInd));
+}
+inline FlatRange FlatView::getFlatRange(Wire wire) const {
+    Size modInd = getModIndex(wire.ref()._ptr);
+    FlatSize numInst = getNumFlatInstanciations(modInd);
+    materialize(modInd);
+    FlatSize begin = _wireEndIndexs[modInd] + numInst * _wireHierToInternal[modInd][wire.ref()._ind];
+    return FlatRange(begin, begin + numInst);
+}
+inline FlatRange FlatView::getFlatRange(Port port) const {
+    Size modInd = getModIndex(port.ref()._ptr);
+    if (port.isModulePort()) {
+        FlatSize numInst = getNumFlatInstanciations(modInd);
+        materialize(modInd);
+        FlatSize begin = _portEndIndexs[modInd] + numInst * _portHierToInternal[modInd][port.ref()._portInd];
+        return FlatRange(begin, begin + numInst);
+    }
+    const DownInfo& down = _children[modInd]._downInfos[port.ref()._instInd];
+    materialize(down._downModIndex);
+    FlatSize begin = _portEndIndexs[down._downModIndex]
+        + getNumFlatInstanciations(down._downModIndex) * _portHierToInternal[down._downModIndex][port.ref()._portInd]
+        + down._offset;
+    return FlatRange(begin, begin + getNumFlatInstanciations(modInd));
+}
+
 inline bool FlatNode::hasName(ID id) { return getObject().hasName(id); }
 inline bool FlatWire::hasName(ID id) { return getObject().hasName(id); }
 inline bool FlatPort::hasName(ID id) { return getObject().hasName(id); }
 inline bool FlatNode::hasProperty(ID id) { return getObject().hasProperty(id); }
 inline bool FlatWire::hasProperty(ID id) { return getObject().hasProperty(id); }
 inline bool FlatPort::hasProperty(ID id) { return getObject().hasProperty(id); }
+inline bool FlatNode::hasAttribute(ID id) { return getObject().hasAttribute(id); }
+inline bool FlatWire::hasAttribute(ID id) { return getObject().hasAttribute(id); }
+inline bool FlatPort::hasAttribute(ID id) { return getObject().hasAttribute(id); }
+inline std::int64_t FlatNode::getAttribute(ID id) { return getObject().getAttribute(id); }
+inline std::int64_t FlatWire::getAttribute(ID id) { return getObject().getAttribute(id); }
+inline std::int64_t FlatPort::getAttribute(ID id) { return getObject().getAttribute(id); }
 inline Names FlatNode::names() { return getObject().names(); }
 inline Names FlatWire::names() { return getObject().names(); }
 inline Names FlatPort::names() { return getObject().names(); }
@@ -346,6 +649,68 @@ inline Properties FlatNode::properties() { return getObject().properties(); }
 inline Properties FlatWire::properties() { return getObject().properties(); }
 inline Properties FlatPort::properties() { return getObject().properties(); }
 
+template<class FlatObject> inline FlatId<FlatObject>::FlatId() : _index(InvalidFlatIndex) {}
+template<class FlatObject> inline FlatId<FlatObject>::FlatId(FlatSize index) : _index(index) {}
+template<class FlatObject> inline FlatSize FlatId<FlatObject>::getIndex() const { return _index; }
+template<class FlatObject> inline bool FlatId<FlatObject>::isValid() const { return _index != InvalidFlatIndex; }
+template<class FlatObject> inline bool FlatId<FlatObject>::operator==(const FlatId& o) const { return _index == o._index; }
+template<class FlatObject> inline bool FlatId<FlatObject>::operator!=(const FlatId& o) const { return _index != o._index; }
+template<class FlatObject> inline bool FlatId<FlatObject>::operator< (const FlatId& o) const { return _index <  o._index; }
+template<class FlatObject> inline bool FlatId<FlatObject>::operator> (const FlatId& o) const { return _index >  o._index; }
+template<class FlatObject> inline bool FlatId<FlatObject>::operator<=(const FlatId& o) const { return _index <= o._index; }
+template<class FlatObject> inline bool FlatId<FlatObject>::operator>=(const FlatId& o) const { return _index >= o._index; }
+
+static_assert(sizeof(FlatNodeId) == sizeof(FlatSize), "Compact flat handles should only hold the index");
+
+inline FlatNodeId FlatNode::getId() { return FlatNodeId(getIndex()); }
+inline FlatWireId FlatWire::getId() { return FlatWireId(getIndex()); }
+inline FlatPortId FlatPort::getId() { return FlatPortId(getIndex()); }
+
+inline FlatModule       FlatView::getFlatModule       (FlatNodeId id) const { return getFlatModuleByIndex(id.getIndex()); }
+inline FlatInstance     FlatView::getFlatInstance     (FlatNodeId id) const { return getFlatInstanceByIndex(id.getIndex()); }
+inline FlatWire         FlatView::getFlatWire         (FlatWireId id) const { return getFlatWireByIndex(id.getIndex()); }
+inline FlatModulePort   FlatView::getFlatModulePort   (FlatPortId id) const { return getFlatModulePortByIndex(id.getIndex()); }
+inline FlatInstancePort FlatView::getFlatInstancePort (FlatPortId id) const { return getFlatInstancePortByIndex(id.getIndex()); }
+
+namespace internal {
+// Enumerates a contiguous range of compact handles
+template<class Id>
+class FlatIdIterator {
+    public:
+    typedef Id value_type;
+    typedef Id reference;
+    typedef Id* pointer;
+    typedef std::int64_t difference_type;
+    typedef std::random_access_iterator_tag iterator_category;
+
+    FlatIdIterator& operator++() { ++_index; return *this; }
+    FlatIdIterator& operator--() { --_index; return *this; }
+    FlatIdIterator& operator+=(difference_type d) { _index += d; return *this; }
+    FlatIdIterator operator+(difference_type d) const { return FlatIdIterator(_index + d); }
+    difference_type operator-(const FlatIdIterator& it) const { return _index - it._index; }
+    bool operator!=(const FlatIdIterator& it) const { return _index != it._index; }
+    bool operator==(const FlatIdIterator& it) const { return _index == it._index; }
+    bool operator< (const FlatIdIterator& it) const { return _index <  it._index; }
+    Id operator*() const { return Id(_index); }
+    Id operator[](difference_type d) const { return Id(_index + d); }
+
+    FlatIdIterator(FlatSize index=0) : _index(index) {}
+
+    private:
+    FlatSize _index;
+};
+} // End namespace gbl::internal
+
+inline FlatNodeIds FlatView::nodeIds() const {
+    return FlatNodeIds(internal::FlatIdIterator<FlatNodeId>(0), internal::FlatIdIterator<FlatNodeId>(getNumFlatModules()));
+}
+inline FlatWireIds FlatView::wireIds() const {
+    return FlatWireIds(internal::FlatIdIterator<FlatWireId>(0), internal::FlatIdIterator<FlatWireId>(getNumFlatWires()));
+}
+inline FlatPortIds FlatView::portIds() const {
+    return FlatPortIds(internal::FlatIdIterator<FlatPortId>(0), internal::FlatIdIterator<FlatPortId>(getNumFlatPorts()));
+}
+
 inline bool FlatNode::operator==(const FlatNode& o) const { return _object == o._object && _ref == o._ref; }
 inline bool FlatNode::operator!=(const FlatNode& o) const { return !operator==(o); }
 inline bool FlatWire::operator==(const FlatWire& o) const { return _object == o._object && _ref == o._ref; }
@@ -356,5 +721,12 @@ inline bool FlatPort::operator!=(const FlatPort& o) const { return !operator==(o
 
 } // End namespace gbl
 
+namespace std {
+template<class FlatObject>
+struct hash<gbl::FlatId<FlatObject> > {
+    size_t operator()(gbl::FlatId<FlatObject> id) const { return hash<gbl::FlatSize>()(id.getIndex()); }
+};
+} // End namespace std
+
 #endif
 
@@ -24,6 +24,7 @@ class Wire;
 class Port;
 class InstancePort;
 class ModulePort;
+class Design;
 
 // Implementation
 
@@ -48,6 +49,7 @@ class NodeFilter;
 class InstanceFilter;
 class NodePortFilter;
 class WirePortFilter;
+class WireLoadFilter;
 
 class WireTransform;
 class NodeTransform;
@@ -58,6 +60,7 @@ class NodePortRefTransform;
 class WirePortRefTransform;
 
 typedef TransformIterator<FilterIterator<PortRefInputIterator, WirePortFilter>, WirePortRefTransform> WirePortIterator;
+typedef TransformIterator<FilterIterator<PortRefInputIterator, WireLoadFilter>, WirePortRefTransform> WireLoadIterator;
 typedef TransformIterator<FilterIterator<PortRefInputIterator, NodePortFilter>, NodePortRefTransform> NodePortIterator;
 typedef TransformIterator<NodePortIterator, ModPortTransform> ModulePortIterator;
 typedef TransformIterator<NodePortIterator, InsPortTransform> InstancePortIterator;
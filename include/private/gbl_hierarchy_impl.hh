@@ -0,0 +1,51 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_HIERARCHY_IMPL_HH
+#define GBL_HIERARCHY_IMPL_HH
+
+namespace gbl {
+
+inline bool HierarchyOrder::isAcyclic() const {
+    return _cycle.empty();
+}
+
+inline std::vector<Module> HierarchyOrder::getCycle() const {
+    return std::vector<Module>(_cycle.begin(), _cycle.end());
+}
+
+inline Size HierarchyOrder::size() const {
+    return _mods.size();
+}
+
+inline Module HierarchyOrder::getModule(Size index) const {
+    assert(index < _mods.size());
+    return Module(_mods[index]);
+}
+
+inline Size HierarchyOrder::getIndex(const internal::ModuleImpl* module) const {
+    if (module->_id >= _id2Index.size()) return InvalidIndex;
+    Size index = _id2Index[module->_id];
+    return index != InvalidIndex && _mods[index] == module ? index : InvalidIndex;
+}
+
+inline Size HierarchyOrder::getIndex(Module module) const {
+    return getIndex(module.ref()._ptr);
+}
+
+inline bool HierarchyOrder::contains(Module module) const {
+    return getIndex(module) != InvalidIndex;
+}
+
+inline const std::vector<Size>& HierarchyOrder::getChildren(Size index) const {
+    assert(index < _children.size());
+    return _children[index];
+}
+
+inline bool HierarchyOrder::isUpToDate() const {
+    return _epoch == internal::hierarchyEpoch().load();
+}
+
+} // End namespace gbl
+
+#endif
+
@@ -8,6 +8,8 @@
 #include <vector>
 #include <cassert>
 #include <atomic>
+#include <mutex>
+#include <algorithm>
 
 namespace gbl {
 namespace internal {
@@ -71,6 +73,11 @@ class XrefList {
 
   Size size() const { return _refs.size(); }
 
+  void clear() {
+    _refs.clear();
+    _freeList = EmptyInd;
+  }
+
   private:
   std::vector<Xref> _refs;
   Size              _freeList;
@@ -88,8 +95,12 @@ class Pool {
   };
 
   public:
+  // Granularity of the occupancy counts
+  static const Size BlockSize = 1024;
+
   Pool() {
     _freeList = EmptyInd;
+    _numUsed = 0;
   }
   bool isValid(Size ind) {
     return ind < _data.size() && _data[ind]._nextFree == UsedInd;
@@ -105,6 +116,11 @@ class Pool {
       _data.emplace_back();
     }
     _data[newAlloc]._nextFree = UsedInd;
+    ++_numUsed;
+    if (newAlloc / BlockSize >= _blockUsed.size()) {
+      _blockUsed.push_back(0);
+    }
+    ++_blockUsed[newAlloc / BlockSize];
     assert(isValid(newAlloc));
     return newAlloc;
   }
@@ -113,6 +129,8 @@ class Pool {
     _data[ind]._val = T();
     _data[ind]._nextFree = _freeList;
     _freeList = ind;
+    --_numUsed;
+    --_blockUsed[ind / BlockSize];
     assert(!isValid(ind));
   }
   T& operator[](Size ind) {
@@ -120,10 +138,115 @@ class Pool {
     return _data[ind]._val;
   }
   Size size() const { return _data.size(); }
+  // Number of allocated elements
+  Size numUsed() const { return _numUsed; }
+  // Number of allocated elements in each block of BlockSize elements, to split the pool in balanced chunks
+  const std::vector<Size>& blockUsed() const { return _blockUsed; }
 
   private:
   std::vector<Elt> _data;
   Size _freeList;
+  Size _numUsed;
+  std::vector<Size> _blockUsed;
+};
+
+/************************************************************************
+ * Dense identifiers for the live modules
+ *    * Recycled when a module is destroyed, so that tables indexed by
+ *      module identifier stay as small as the number of live modules
+ ************************************************************************/
+
+class ModuleIdAllocator {
+  public:
+  Size allocate() {
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_freeIds.empty()) {
+      return _nextId++;
+    }
+    Size ret = _freeIds.back();
+    _freeIds.pop_back();
+    return ret;
+  }
+
+  void release(Size id) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _freeIds.push_back(id);
+  }
+
+  static ModuleIdAllocator& get() {
+    static ModuleIdAllocator allocator;
+    return allocator;
+  }
+
+  private:
+  ModuleIdAllocator() : _nextId(0) {}
+
+  private:
+  std::vector<Size>  _freeIds;
+  Size               _nextId;
+  std::mutex         _lock;
+};
+
+/************************************************************************
+ * Version of the instanciation graph
+ *    * Incremented whenever an instance is created or destroyed, or a
+ *      module is destroyed, so that hierarchy orders can be cached
+ ************************************************************************/
+
+inline std::atomic<std::uint64_t>& hierarchyEpoch() {
+  static std::atomic<std::uint64_t> epoch(0);
+  return epoch;
+}
+
+/************************************************************************
+ * Version of the port directions
+ *    * Incremented whenever the direction of a module port changes, so
+ *      that the drivers cached on the wires can be validated; 0 is never
+ *      a valid version
+ ************************************************************************/
+
+inline std::atomic<std::uint64_t>& directionEpoch() {
+  static std::atomic<std::uint64_t> epoch(1);
+  return epoch;
+}
+
+// Slot of the driver in the connections of a wire, valid for a single direction version
+// Invalidated by the connection edits of the wire; copies are invalid
+struct DriverCache {
+  std::atomic<std::uint64_t> _epoch;
+  std::atomic<Size>          _slot;
+
+  DriverCache() : _epoch(0), _slot(EmptyInd) {}
+  DriverCache(const DriverCache&) : DriverCache() {}
+  DriverCache& operator=(const DriverCache&) { invalidate(); return *this; }
+
+  void invalidate() { _epoch.store(0, std::memory_order_relaxed); }
+};
+
+/************************************************************************
+ * Notification of the edits of a module
+ *    * Derived views subscribe to the modules they depend on, and are
+ *      told which kind of object was created or destroyed; instance edits
+ *      also give the node, or InvalidIndex if any node may have changed
+ *    * Subscription is synchronized, since views of a module may be built
+ *      by several readers; like the edits themselves, notification is not
+ *    * Views are caches, that const queries bring up to date: they are
+ *      notified through const pointers and record the edits in mutable state
+ ************************************************************************/
+
+class ModuleObserver {
+  public:
+  enum EditType {
+    WireEdit,
+    PortEdit,
+    InstanceEdit,
+    Destruction
+  };
+
+  virtual void notifyEdit(ModuleImpl* module, EditType edit, Size index) const = 0;
+
+  protected:
+  ~ModuleObserver() {}
 };
 
 /************************************************************************
@@ -146,7 +269,8 @@ struct NodeImpl : public BaseImpl {
 
 struct WireImpl : public BaseImpl {
   // Cross-references for the connections, with an embedded freelist
-  XrefList _refs;
+  XrefList    _refs;
+  DriverCache _driver;
 };
 
 struct ModuleImpl {
@@ -156,22 +280,109 @@ struct ModuleImpl {
   std::atomic<std::uint64_t> _refcnt;
 
   Size _firstFreePort;
+  // Number of valid ports, so that they can be counted without a traversal
+  Size _numPorts;
+  // Direction of each port (Symbol::DIR_*), 0 if unknown; read directly through the instance ports
+  std::vector<std::uint8_t> _portDirs;
   bool _leaf;
 
+  // Dense identifier among the live modules
+  Size _id;
+
+  // Owning design, if any, and dense identifier in this design
+  Design* _design;
+  Size    _designId;
+
+  std::vector<const ModuleObserver*> _observers;
+  std::mutex                   _observerLock;
+
+  // Sequence number of the edits: odd while a guarded write is in progress
+  std::atomic<std::uint64_t> _version;
+  // Serializes the guarded writers
+  std::mutex                 _writeLock;
+
   ModuleImpl(bool leaf);
+  ~ModuleImpl();
+
+  void subscribe(const ModuleObserver* observer);
+  void unsubscribe(const ModuleObserver* observer);
+  void notify(ModuleObserver::EditType edit, Size index=InvalidIndex);
+  // Records an edit that the observers don't need to know about: connections, directions and data
+  void touch();
 };
 
 inline
 ModuleImpl::ModuleImpl(bool leaf)
 : _refcnt(0)
 , _firstFreePort(EmptyInd)
+, _numPorts(0)
 , _leaf(leaf)
+, _id(ModuleIdAllocator::get().allocate())
+, _design(nullptr)
+, _designId(InvalidIndex)
+, _version(0)
 {
     Size interfaceInd = _nodes.allocate();
     assert(interfaceInd == 0);
     _nodes[0]._instanciation = this;
 }
 
+inline
+ModuleImpl::~ModuleImpl() {
+    notify(ModuleObserver::Destruction);
+    ++hierarchyEpoch();
+    ModuleIdAllocator::get().release(_id);
+}
+
+inline void
+ModuleImpl::subscribe(const ModuleObserver* observer) {
+    std::lock_guard<std::mutex> guard(_observerLock);
+    _observers.push_back(observer);
+}
+
+inline void
+ModuleImpl::unsubscribe(const ModuleObserver* observer) {
+    std::lock_guard<std::mutex> guard(_observerLock);
+    auto it = std::find(_observers.begin(), _observers.end(), observer);
+    assert(it != _observers.end());
+    _observers.erase(it);
+}
+
+inline void
+ModuleImpl::touch() {
+    // Keeps the parity: readers see the change whether or not the writer holds the guard
+    _version.fetch_add(2, std::memory_order_release);
+}
+
+inline void
+ModuleImpl::notify(ModuleObserver::EditType edit, Size index) {
+    touch();
+    for (const ModuleObserver* observer : _observers) {
+        observer->notifyEdit(this, edit, index);
+    }
+}
+
+// Moves the port i of a node to the port portMap[i], disconnecting the unmapped ports
+void remapPorts(ModuleImpl* module, Size nodeInd, const std::vector<Size>& portMap);
+
+// Finds the driver of a wire and caches it
+Size updateDriver(ModuleImpl* module, Size wireInd);
+
+// True for the Symbol::DIR_* properties
+bool isDirection(ID id);
+// Sets the direction of a module port and replaces its DIR_* properties
+void setPortDirection(ModuleImpl* module, Size portInd, ID dir);
+// Updates the direction of a module port after a DIR_* property was added (or erased if 0)
+void syncPortDirection(ModuleImpl* module, Size portInd, ID added);
+
+inline Size getDriverSlot(ModuleImpl* module, Size wireInd) {
+    const DriverCache& cache = module->_wires[wireInd]._driver;
+    if (cache._epoch.load(std::memory_order_acquire) == directionEpoch().load(std::memory_order_relaxed)) {
+        return cache._slot.load(std::memory_order_relaxed);
+    }
+    return updateDriver(module, wireInd);
+}
+
 inline
 NodeImpl::NodeImpl()
 : _instanciation(nullptr)
@@ -240,7 +451,9 @@ inline bool Module::isHier() { return !_ref._ptr->_leaf; }
 inline Wire
 Module::createWire() {
     assert(isValid());
-    return Wire(_ref._ptr, _ref._ptr->_wires.allocate());
+    Size ind = _ref._ptr->_wires.allocate();
+    _ref._ptr->notify(internal::ModuleObserver::WireEdit);
+    return Wire(_ref._ptr, ind);
 }
 
 inline Instance
@@ -248,6 +461,8 @@ Module::createInstance(Module instanciated) {
     assert(isValid());
     Size ind = _ref._ptr->_nodes.allocate();
     _ref._ptr->_nodes[ind]._instanciation = instanciated._ref._ptr;
+    ++internal::hierarchyEpoch();
+    _ref._ptr->notify(internal::ModuleObserver::InstanceEdit, ind);
     return Instance(Node(_ref._ptr, ind));
 }
 
@@ -264,6 +479,11 @@ Module::createPort() {
         _ref._ptr->_firstFreePort = _ref._ptr->_nodes[0]._refs[newPortInd]._ind;
         _ref._ptr->_nodes[0]._refs[newPortInd] = internal::Xref::Disconnected();
     }
+    if (_ref._ptr->_portDirs.size() <= newPortInd) {
+        _ref._ptr->_portDirs.resize(newPortInd+1, 0);
+    }
+    ++_ref._ptr->_numPorts;
+    _ref._ptr->notify(internal::ModuleObserver::PortEdit);
     return ModulePort(Port(_ref._ptr, 0, newPortInd));
 }
 
@@ -296,6 +516,33 @@ inline Node Port::getNode() { return Node(_ref._ptr, _ref._instInd); }
 inline Instance InstancePort::getInstance() { return Instance(getNode()); }
 inline Module Instance::getDownModule() { return _ref._ptr->_nodes[_ref._ind]._instanciation; }
 
+inline ID
+Port::getDirection() {
+    assert(isValid());
+    const std::vector<std::uint8_t>& dirs = _ref._ptr->_nodes[_ref._instInd]._instanciation->_portDirs;
+    return _ref._portInd < dirs.size() ? dirs[_ref._portInd] : 0;
+}
+
+inline void
+ModulePort::setDirection(ID dir) {
+    assert(isValid());
+    assert(dir < 256);
+    assert(dir == 0 || internal::isDirection(dir));
+    internal::setPortDirection(_ref._ptr, _ref._portInd, dir);
+    _ref._ptr->touch();
+}
+
+inline Port
+Wire::getDriver() {
+    assert(isValid());
+    Size slot = internal::getDriverSlot(_ref._ptr, _ref._ind);
+    if (slot == internal::EmptyInd) {
+        return Port();
+    }
+    const internal::Xref& ref = _ref._ptr->_wires[_ref._ind]._refs[slot];
+    return Port(_ref._ptr, ref._obj_id, ref._ind);
+}
+
 inline ModulePort
 InstancePort::getDownPort() {
     assert(isValid());
@@ -360,6 +607,8 @@ Port::connect(Wire wire) {
     internal::Xref& wireRef = _ref._ptr->_wires[wire._ref._ind]._refs[wirePortInd];
     wireRef._obj_id = _ref._instInd;
     wireRef._ind    = _ref._portInd;
+    _ref._ptr->_wires[wire._ref._ind]._driver.invalidate();
+    _ref._ptr->touch();
 }
 
 inline void
@@ -369,7 +618,9 @@ Port::disconnect() {
     assert(isConnected());
     internal::Xref& instRef = _ref._ptr->_nodes[_ref._instInd]._refs[_ref._portInd];
     _ref._ptr->_wires[instRef._obj_id]._refs.erase(instRef._ind);
+    _ref._ptr->_wires[instRef._obj_id]._driver.invalidate();
     instRef = internal::Xref::Disconnected();
+    _ref._ptr->touch();
 }
 
 inline void
@@ -379,9 +630,11 @@ Node::disconnectAll() {
     for (Size i=0; i<nodeRefs.size(); ++i) {
         if (nodeRefs[i].isValid() && nodeRefs[i].isConnected()) {
             _ref._ptr->_wires[nodeRefs[i]._obj_id]._refs.erase(nodeRefs[i]._ind);
+            _ref._ptr->_wires[nodeRefs[i]._obj_id]._driver.invalidate();
             nodeRefs[i] = internal::Xref::Disconnected(); // Works for both instances and modules (but for an instance we could just deallocate/invalidate everything)
         }
     }
+    _ref._ptr->touch();
 }
 
 inline void
@@ -394,6 +647,8 @@ Wire::disconnectAll() {
             wireRefs.erase(i);
         }
     }
+    _ref._ptr->_wires[_ref._ind]._driver.invalidate();
+    _ref._ptr->touch();
 }
 
 
@@ -402,14 +657,43 @@ Instance::destroy() {
     assert(isValid());
     disconnectAll();
     _ref._ptr->_nodes.deallocate(_ref._ind);
+    ++internal::hierarchyEpoch();
+    _ref._ptr->notify(internal::ModuleObserver::InstanceEdit, _ref._ind);
     assert(!isValid());
 }
 
+inline void
+Instance::replaceModule(Module mod) {
+    assert(isValid());
+    assert(mod.isValid());
+    internal::NodeImpl& node = _ref._ptr->_nodes[_ref._ind];
+    const std::vector<internal::Xref>& newPorts = mod.ref()._ptr->_nodes[0]._refs;
+    // Only the ports that don't exist in the new module need an update, but the directions may change
+    for (Size i=0; i<node._refs.size(); ++i) {
+        if (!node._refs[i].isValid() || !node._refs[i].isConnected()) continue;
+        _ref._ptr->_wires[node._refs[i]._obj_id]._driver.invalidate();
+        if (i < newPorts.size() && newPorts[i].isValid()) continue;
+        _ref._ptr->_wires[node._refs[i]._obj_id]._refs.erase(node._refs[i]._ind);
+        node._refs[i] = internal::Xref::Disconnected();
+    }
+    for (Size i=0; i<node._refData.size(); ++i) {
+        if (i >= newPorts.size() || !newPorts[i].isValid()) {
+            node._refData[i] = internal::DataImpl();
+        }
+    }
+    if (node._refs.size() > newPorts.size()) node._refs.erase(node._refs.begin() + newPorts.size(), node._refs.end());
+    if (node._refData.size() > newPorts.size()) node._refData.erase(node._refData.begin() + newPorts.size(), node._refData.end());
+    node._instanciation = mod.ref()._ptr;
+    ++internal::hierarchyEpoch();
+    _ref._ptr->notify(internal::ModuleObserver::InstanceEdit, _ref._ind);
+}
+
 inline void
 Wire::destroy() {
     assert(isValid());
     disconnectAll();
     _ref._ptr->_wires.deallocate(_ref._ind);
+    _ref._ptr->notify(internal::ModuleObserver::WireEdit);
     assert(!isValid());
 }
 
@@ -423,6 +707,9 @@ ModulePort::destroy() {
     _ref._ptr->_nodes[0]._refs[_ref._portInd] = internal::Xref::Invalid();
     _ref._ptr->_nodes[0]._refs[_ref._portInd]._ind = _ref._ptr->_firstFreePort;
     _ref._ptr->_firstFreePort = _ref._portInd;
+    internal::setPortDirection(_ref._ptr, _ref._portInd, 0);
+    --_ref._ptr->_numPorts;
+    _ref._ptr->notify(internal::ModuleObserver::PortEdit);
     assert(!isValid());
 }
 
@@ -471,21 +758,45 @@ inline bool Wire::hasProperty(ID id) {
 }
 inline bool Wire::addName(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     return _ref._ptr->_wires[_ref._ind]._data.addName(id);
 }
 inline bool Wire::addProperty(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     return _ref._ptr->_wires[_ref._ind]._data.addProp(id);
 }
 inline bool Wire::eraseName(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     return _ref._ptr->_wires[_ref._ind]._data.eraseName(id);
 }
 inline bool Wire::eraseProperty(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     return _ref._ptr->_wires[_ref._ind]._data.eraseProp(id);
 }
 
+inline bool Wire::hasAttribute(ID id) {
+    assert(isValid());
+    return _ref._ptr->_wires[_ref._ind]._data.hasAttr(id);
+}
+inline std::int64_t Wire::getAttribute(ID id) {
+    assert(isValid());
+    assert(hasAttribute(id));
+    return _ref._ptr->_wires[_ref._ind]._data.getAttr(id)._val._int64;
+}
+inline bool Wire::setAttribute(ID id, std::int64_t val) {
+    assert(isValid());
+    _ref._ptr->touch();
+    return _ref._ptr->_wires[_ref._ind]._data.setAttr(internal::Attribute::makeInt64(id, val));
+}
+inline bool Wire::eraseAttribute(ID id) {
+    assert(isValid());
+    _ref._ptr->touch();
+    return _ref._ptr->_wires[_ref._ind]._data.eraseAttr(id);
+}
+
 inline bool Node::hasName(ID id) {
     assert(isValid());
     return _ref._ptr->_nodes[_ref._ind]._data.hasName(id);
@@ -496,21 +807,45 @@ inline bool Node::hasProperty(ID id) {
 }
 inline bool Node::addName(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     return _ref._ptr->_nodes[_ref._ind]._data.addName(id);
 }
 inline bool Node::addProperty(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     return _ref._ptr->_nodes[_ref._ind]._data.addProp(id);
 }
 inline bool Node::eraseName(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     return _ref._ptr->_nodes[_ref._ind]._data.eraseName(id);
 }
 inline bool Node::eraseProperty(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     return _ref._ptr->_nodes[_ref._ind]._data.eraseProp(id);
 }
 
+inline bool Node::hasAttribute(ID id) {
+    assert(isValid());
+    return _ref._ptr->_nodes[_ref._ind]._data.hasAttr(id);
+}
+inline std::int64_t Node::getAttribute(ID id) {
+    assert(isValid());
+    assert(hasAttribute(id));
+    return _ref._ptr->_nodes[_ref._ind]._data.getAttr(id)._val._int64;
+}
+inline bool Node::setAttribute(ID id, std::int64_t val) {
+    assert(isValid());
+    _ref._ptr->touch();
+    return _ref._ptr->_nodes[_ref._ind]._data.setAttr(internal::Attribute::makeInt64(id, val));
+}
+inline bool Node::eraseAttribute(ID id) {
+    assert(isValid());
+    _ref._ptr->touch();
+    return _ref._ptr->_nodes[_ref._ind]._data.eraseAttr(id);
+}
+
 inline bool Port::hasName(ID id) {
     assert(isValid());
     if (_ref._ptr->_nodes[_ref._instInd]._refData.size() <= _ref._portInd) return false;
@@ -523,6 +858,7 @@ inline bool Port::hasProperty(ID id) {
 }
 inline bool Port::addName(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     if (_ref._ptr->_nodes[_ref._instInd]._refData.size() <= _ref._portInd) {
         _ref._ptr->_nodes[_ref._instInd]._refData.resize(_ref._portInd+1);
     }
@@ -530,29 +866,58 @@ inline bool Port::addName(ID id) {
 }
 inline bool Port::addProperty(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     if (_ref._ptr->_nodes[_ref._instInd]._refData.size() <= _ref._portInd) {
         _ref._ptr->_nodes[_ref._instInd]._refData.resize(_ref._portInd+1);
     }
-    return _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].addProp(id);
+    bool added = _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].addProp(id);
+    if (_ref._instInd == 0 && internal::isDirection(id)) {
+        internal::syncPortDirection(_ref._ptr, _ref._portInd, id);
+    }
+    return added;
 }
 inline bool Port::eraseName(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     if (_ref._ptr->_nodes[_ref._instInd]._refData.size() <= _ref._portInd) return false;
     return _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].eraseName(id);
 }
 inline bool Port::eraseProperty(ID id) {
     assert(isValid());
+    _ref._ptr->touch();
     if (_ref._ptr->_nodes[_ref._instInd]._refData.size() <= _ref._portInd) return false;
-    return _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].eraseProp(id);
+    bool erased = _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].eraseProp(id);
+    if (erased && _ref._instInd == 0 && _ref._ptr->_portDirs[_ref._portInd] == id) {
+        internal::syncPortDirection(_ref._ptr, _ref._portInd, 0);
+    }
+    return erased;
+}
+
+inline bool Port::hasAttribute(ID id) {
+    assert(isValid());
+    if (_ref._ptr->_nodes[_ref._instInd]._refData.size() <= _ref._portInd) return false;
+    return _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].hasAttr(id);
+}
+inline std::int64_t Port::getAttribute(ID id) {
+    assert(isValid());
+    assert(hasAttribute(id));
+    return _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].getAttr(id)._val._int64;
+}
+inline bool Port::setAttribute(ID id, std::int64_t val) {
+    assert(isValid());
+    _ref._ptr->touch();
+    if (_ref._ptr->_nodes[_ref._instInd]._refData.size() <= _ref._portInd) {
+        _ref._ptr->_nodes[_ref._instInd]._refData.resize(_ref._portInd+1);
+    }
+    return _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].setAttr(internal::Attribute::makeInt64(id, val));
+}
+inline bool Port::eraseAttribute(ID id) {
+    assert(isValid());
+    _ref._ptr->touch();
+    if (_ref._ptr->_nodes[_ref._instInd]._refData.size() <= _ref._portInd) return false;
+    return _ref._ptr->_nodes[_ref._instInd]._refData[_ref._portInd].eraseAttr(id);
 }
 
 } // End namespace gbl
 
 #endif
-
-
-
-
-
-
-
@@ -41,6 +41,12 @@ class FilterIterator {
     typename InputIterator::reference operator*() {
         return *_cur;
     }
+
+    // Underlying iterators, to split a traversal
+    const InputIterator& base() const { return _cur; }
+    const InputIterator& baseEnd() const { return _end; }
+    const Predicate& predicate() const { return _pred; }
+
     FilterIterator(InputIterator cur=InputIterator(), InputIterator end=InputIterator(), Predicate pred=Predicate())
         : _cur(cur), _end(end), _pred(pred) {
         while(_cur != _end && !_pred(*_cur)) {
@@ -68,6 +74,11 @@ class TransformIterator {
     auto operator*() -> value_type {
         return _func(*_it);
     }
+
+    // Underlying iterator, to split a traversal
+    const InputIterator& base() const { return _it; }
+    const UnaryFunction& functor() const { return _func; }
+
     TransformIterator(InputIterator it=InputIterator(), UnaryFunction func=UnaryFunction()) : _it(it), _func(func) {}
 };
 
@@ -122,6 +133,10 @@ struct NodeFilter { bool operator()(EltRef node){ return node.isValidNodeRef();
 struct InstanceFilter { bool operator()(Node node){ return node.isInstance(); } };
 struct NodePortFilter { bool operator()(PortRef port){ return port.isValidNodePortRef(); } };
 struct WirePortFilter { bool operator()(PortRef port){ return port.isValidWirePortRef(); } };
+struct WireLoadFilter {
+    Size _driver;
+    bool operator()(PortRef port){ return port._portInd != _driver && port.isValidWirePortRef(); }
+};
 
 struct WireTransform {
     Wire operator()(EltRef ref){ return Wire(ref._ptr, ref._ind); }
@@ -229,6 +244,16 @@ Wire::ports() {
     ), internal::WirePortRefTransform());
 }
 
+inline Wire::Loads
+Wire::loads() {
+    assert(isValid());
+    return getTransformContainer(getFilterContainer(
+        internal::PortRefInputIterator(PortRef(_ref._ptr, _ref._ind, 0)),
+        internal::PortRefInputIterator(PortRef(_ref._ptr, _ref._ind, _ref._ptr->_wires[_ref._ind]._refs.size())),
+        internal::WireLoadFilter{internal::getDriverSlot(_ref._ptr, _ref._ind)}
+    ), internal::WirePortRefTransform());
+}
+
 inline Instance::Ports
 Instance::ports() {
     assert(isValid());
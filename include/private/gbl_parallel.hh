@@ -0,0 +1,218 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_PARALLEL_HH
+#define GBL_PARALLEL_HH
+
+#include "gbl_forward_declarations.hh"
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <cassert>
+
+namespace gbl {
+namespace internal {
+
+/************************************************************************
+ * Work-stealing scheduler
+ *    * Each thread runs the tasks it spawned last first, and idle threads
+ *      steal the oldest tasks of the others
+ *    * A thread waiting for a task group runs the queued tasks of this
+ *      group meanwhile, so that groups can be nested; it doesn't run
+ *      unrelated tasks, that could wait for a lock it holds
+ *    * The algorithms below split the work depending on the size of the
+ *      range only: their results don't depend on the number of threads or
+ *      on the scheduling
+ ************************************************************************/
+
+class TaskGroup;
+
+class ThreadPool {
+  public:
+  unsigned getNumThreads() const { return _queues.size(); }
+  // Also controlled by the GBL_NUM_THREADS environment variable; no task may be running
+  void setNumThreads(unsigned numThreads);
+
+  // Test mode: tasks run in random order and are stolen from random threads
+  // Also controlled by the GBL_RANDOM_SCHEDULING environment variable
+  void setRandomScheduling(bool random) { _random = random; }
+  bool isRandomScheduling() const { return _random; }
+
+  static ThreadPool& get();
+
+  ~ThreadPool();
+
+  private:
+  friend TaskGroup;
+
+  struct Task {
+    std::function<void()> _func;
+    TaskGroup*            _group;
+  };
+  struct WorkQueue {
+    std::mutex       _lock;
+    std::deque<Task> _tasks;
+  };
+
+  ThreadPool();
+  void startThreads(unsigned numThreads);
+  void stopThreads();
+  void workerLoop(unsigned threadIndex);
+
+  void push(Task&& task);
+  bool pop(Task& task, const TaskGroup* group);
+  // Runs a queued task of the group (any task if null) if there is one
+  bool runOneTask(const TaskGroup* group=nullptr);
+
+  private:
+  std::vector<std::thread> _threads;
+  // One queue per worker; threads outside the pool share the first one
+  std::vector<std::unique_ptr<WorkQueue> > _queues;
+  std::atomic<std::int64_t> _numQueued;
+
+  // Sleep of the idle workers
+  std::mutex              _sleepLock;
+  std::condition_variable _wakeCond;
+  std::atomic<unsigned>   _numSleeping;
+  bool                    _stop;
+
+  std::atomic<bool>       _random;
+};
+
+// Tasks that can be waited for together
+class TaskGroup {
+  public:
+  template<class Func>
+  void run(Func func);
+  // Runs the tasks of the group until all of them are done
+  void wait();
+
+  TaskGroup() : _pending(0) {}
+  ~TaskGroup() { wait(); }
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  private:
+  friend ThreadPool;
+  std::atomic<Size> _pending;
+};
+
+template<class Func>
+void TaskGroup::run(Func func) {
+    ThreadPool& pool = ThreadPool::get();
+    if (pool.getNumThreads() == 1 && !pool.isRandomScheduling()) {
+        func();
+        return;
+    }
+    ++_pending;
+    pool.push(ThreadPool::Task{std::function<void()>(func), this});
+}
+
+// The algorithms below take 64-bit bounds and indexes, so that they can run over flat objects
+
+// Size of the chunks for a range: at most 256 chunks, whatever the number of threads
+inline FlatSize getDefaultGrain(FlatSize numIndexes) {
+    return std::max<FlatSize>(1, (numIndexes + 255) / 256);
+}
+
+// Split point of a range, on a multiple of the grain
+inline FlatSize getSplitIndex(FlatSize begin, FlatSize end, FlatSize grain) {
+    FlatSize numChunks = (end - begin + grain - 1) / grain;
+    return begin + (numChunks / 2) * grain;
+}
+
+template<class Func>
+void parallelForChunks(FlatSize begin, FlatSize end, FlatSize grain, const Func& func) {
+    if (end - begin <= grain) {
+        for (FlatSize i=begin; i<end; ++i) {
+            func(i);
+        }
+        return;
+    }
+    FlatSize mid = getSplitIndex(begin, end, grain);
+    TaskGroup group;
+    group.run([&]() { parallelForChunks(begin, mid, grain, func); });
+    parallelForChunks(mid, end, grain, func);
+    group.wait();
+}
+
+// Runs func(i) for each i in [begin, end), in chunks of grain indexes
+template<class Func>
+void parallelFor(FlatSize begin, FlatSize end, FlatSize grain, Func func) {
+    assert(grain > 0);
+    if (end > begin) {
+        parallelForChunks(begin, end, grain, func);
+    }
+}
+
+template<class Func>
+void parallelFor(FlatSize begin, FlatSize end, Func func) {
+    parallelFor(begin, end, getDefaultGrain(end > begin ? end - begin : 0), func);
+}
+
+// Reduction of func(i) for each i in [begin, end)
+// Each chunk is reduced in order, then the chunks are combined in a fixed binary tree:
+// the result is the same for non-associative operations, such as floating point sums
+template<class T, class Func, class Combine>
+T parallelReduce(FlatSize begin, FlatSize end, FlatSize grain, T identity, Func func, Combine combine) {
+    assert(grain > 0);
+    if (end <= begin + grain) {
+        T acc = identity;
+        for (FlatSize i=begin; i<end; ++i) {
+            acc = combine(acc, func(i));
+        }
+        return acc;
+    }
+    FlatSize mid = getSplitIndex(begin, end, grain);
+    T left = identity;
+    TaskGroup group;
+    group.run([&]() { left = parallelReduce(begin, mid, grain, identity, func, combine); });
+    T right = parallelReduce(mid, end, grain, identity, func, combine);
+    group.wait();
+    return combine(left, right);
+}
+
+// In-place exclusive prefix sum; returns the total
+template<class T>
+T parallelExclusiveScan(std::vector<T>& values) {
+    const FlatSize blockSize = 4096;
+    FlatSize n = values.size();
+    FlatSize numBlocks = (n + blockSize - 1) / blockSize;
+    // Sum of each block, then offset of each block, then scan of each block
+    std::vector<T> blockSums(numBlocks, T());
+    parallelFor(0, numBlocks, 1, [&](FlatSize b) {
+        T sum = T();
+        for (FlatSize i = b * blockSize; i < std::min(n, (b+1) * blockSize); ++i) {
+            sum += values[i];
+        }
+        blockSums[b] = sum;
+    });
+    T total = T();
+    for (T& s : blockSums) {
+        T cur = s;
+        s = total;
+        total += cur;
+    }
+    parallelFor(0, numBlocks, 1, [&](FlatSize b) {
+        T sum = blockSums[b];
+        for (FlatSize i = b * blockSize; i < std::min(n, (b+1) * blockSize); ++i) {
+            T cur = values[i];
+            values[i] = sum;
+            sum += cur;
+        }
+    });
+    return total;
+}
+
+} // End namespace gbl::internal
+} // End namespace gbl
+
+#endif
+
@@ -0,0 +1,107 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#ifndef GBL_SUMMARIES_IMPL_HH
+#define GBL_SUMMARIES_IMPL_HH
+
+#include "gbl_parallel.hh"
+
+#include <algorithm>
+
+namespace gbl {
+
+template<class T>
+inline ModuleSummaries<T>::Entry::Entry(Module module, std::uint64_t version, std::uint64_t stamp, T&& value)
+: _module(module)
+, _version(version)
+, _stamp(stamp)
+, _value(std::move(value))
+{
+}
+
+template<class T>
+inline ModuleSummaries<T>::ModuleSummaries(Function func)
+: _func(func)
+, _numEvaluations(0)
+{
+}
+
+template<class T>
+inline bool ModuleSummaries<T>::isUpToDate(const HierarchyOrder& order, Size index) const {
+    internal::ModuleImpl* module = order.getModule(index).ref()._ptr;
+    if (module->_id >= _entries.size()) return false;
+    const Entry* entry = _entries[module->_id].get();
+    if (entry == nullptr || entry->_version != module->_version.load(std::memory_order_acquire)) {
+        return false;
+    }
+    // The children are up to date already: they were evaluated again if they were edited
+    for (Size child : order.getChildren(index)) {
+        if (_entries[order.getModule(child).ref()._ptr->_id]->_stamp > entry->_stamp) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class T>
+inline void ModuleSummaries<T>::evaluate(const HierarchyOrder& order, Size index) {
+    Module module = order.getModule(index);
+    std::uint64_t version = module.ref()._ptr->_version.load(std::memory_order_acquire);
+    T value = _func(module, *this);
+    std::uint64_t stamp = ++_numEvaluations;
+    _entries[module.ref()._ptr->_id].reset(new Entry(module, version, stamp, std::move(value)));
+}
+
+template<class T>
+inline const T* ModuleSummaries<T>::get(Module module) {
+    std::shared_ptr<const HierarchyOrder> order = HierarchyOrder::get(module);
+    if (!order->isAcyclic()) {
+        return nullptr;
+    }
+    // Height of each module above the leaves: modules of the same height are independent
+    std::vector<Size> heights(order->size(), 0);
+    Size maxId = 0;
+    for (Size i=order->size(); i-- > 0;) {
+        for (Size child : order->getChildren(i)) {
+            heights[i] = std::max(heights[i], heights[child] + 1);
+        }
+        maxId = std::max(maxId, order->getModule(i).ref()._ptr->_id);
+    }
+    if (_entries.size() <= maxId) {
+        _entries.resize(maxId + 1);
+    }
+    std::vector<std::vector<Size> > levels(heights[0] + 1);
+    for (Size i=0; i<order->size(); ++i) {
+        levels[heights[i]].push_back(i);
+    }
+    for (const std::vector<Size>& level : levels) {
+        internal::parallelFor(0, level.size(), 1, [&](Size i) {
+            if (!isUpToDate(*order, level[i])) {
+                evaluate(*order, level[i]);
+            }
+        });
+    }
+    return &_entries[module.ref()._ptr->_id]->_value;
+}
+
+template<class T>
+inline const T& ModuleSummaries<T>::getChild(Module child) const {
+    assert(child.ref()._ptr->_id < _entries.size());
+    const Entry* entry = _entries[child.ref()._ptr->_id].get();
+    assert(entry != nullptr && entry->_module == child);
+    return entry->_value;
+}
+
+template<class T>
+inline std::uint64_t ModuleSummaries<T>::getNumEvaluations() const {
+    return _numEvaluations.load();
+}
+
+template<class T>
+inline void ModuleSummaries<T>::clear() {
+    _entries.clear();
+}
+
+} // End namespace gbl
+
+#endif
+
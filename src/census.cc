@@ -0,0 +1,74 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl_census.hh"
+#include "gbl_hierarchy.hh"
+
+#include <numeric>
+
+namespace gbl {
+
+LeafCensus::LeafCensus(const FlatView& view)
+: _view(view)
+, _epoch(view.getEpoch())
+{
+    compute(false, 0);
+}
+
+LeafCensus::LeafCensus(const FlatView& view, ID attribute)
+: _view(view)
+, _epoch(view.getEpoch())
+{
+    compute(true, attribute);
+}
+
+void LeafCensus::compute(bool hasAttribute, ID attribute) {
+    std::shared_ptr<const HierarchyOrder> order = HierarchyOrder::get(_view.getTop().getObject());
+    if (!order->isAcyclic()) {
+        // Empty view
+        return;
+    }
+    std::vector<FlatSize> counts(order->size(), 0);
+    std::vector<std::int64_t> sums(order->size(), 0);
+    std::vector<std::int64_t> moduleValues(order->size(), 0);
+    for (Size i=0; i<order->size(); ++i) {
+        Module module = order->getModule(i);
+        if (hasAttribute && module.isLeaf() && module.hasAttribute(attribute)) {
+            moduleValues[i] = module.getAttribute(attribute);
+        }
+    }
+    for (Size i=0; i<order->size(); ++i) {
+        Module module = order->getModule(i);
+        if (module.isLeaf()) continue;
+        // Occurrences of each instance of the module
+        FlatSize multiplicity = _view.getNumFlatInstanciations(module);
+        for (Instance inst : module.instances()) {
+            Module down = inst.getDownModule();
+            if (!down.isLeaf()) continue;
+            Size downIndex = order->getIndex(down);
+            counts[downIndex] += multiplicity;
+            if (hasAttribute) {
+                std::int64_t value = inst.hasAttribute(attribute) ? inst.getAttribute(attribute) : moduleValues[downIndex];
+                sums[downIndex] += value * static_cast<std::int64_t>(multiplicity);
+            }
+        }
+    }
+    for (Size i=0; i<order->size(); ++i) {
+        if (counts[i] == 0) continue;
+        _modules.push_back(order->getModule(i));
+        _counts.push_back(counts[i]);
+        _sums.push_back(sums[i]);
+    }
+}
+
+FlatSize LeafCensus::getTotalCount() const {
+    assert(!isStale());
+    return std::accumulate(_counts.begin(), _counts.end(), FlatSize(0));
+}
+
+std::int64_t LeafCensus::getTotalAttributeSum() const {
+    assert(!isStale());
+    return std::accumulate(_sums.begin(), _sums.end(), std::int64_t(0));
+}
+
+} // End namespace gbl
+
@@ -0,0 +1,133 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl_design.hh"
+
+namespace gbl {
+
+Design::Design() {
+}
+
+Design::~Design() {
+    for (Size id : getTeardownOrder()) {
+        internal::ModuleImpl* module = _modules[id];
+        module->_design = nullptr;
+        module->_designId = InvalidIndex;
+        if (--module->_refcnt == 0) {
+            delete module;
+        }
+    }
+}
+
+Module Design::createHier() {
+    Module module = Module::createHier();
+    add(module);
+    return module;
+}
+
+Module Design::createLeaf() {
+    Module module = Module::createLeaf();
+    add(module);
+    return module;
+}
+
+void Design::add(Module module) {
+    internal::ModuleImpl* ptr = module.ref()._ptr;
+    assert(ptr->_design == nullptr);
+    ptr->_design = this;
+    ptr->_designId = _modules.size();
+    ++ptr->_refcnt;
+    _modules.push_back(ptr);
+}
+
+void Design::remove(Module module) {
+    assert(contains(module));
+    internal::ModuleImpl* ptr = module.ref()._ptr;
+    Size id = ptr->_designId;
+    _modules[id] = _modules.back();
+    _modules[id]->_designId = id;
+    _modules.pop_back();
+    ptr->_design = nullptr;
+    ptr->_designId = InvalidIndex;
+    // The module is still referenced by the argument
+    --ptr->_refcnt;
+}
+
+std::vector<Size> Design::compactPorts(Module module) {
+    internal::ModuleImpl* ptr = module.ref()._ptr;
+    std::vector<internal::Xref>& interface = ptr->_nodes[0]._refs;
+    std::vector<Size> mapping(interface.size(), InvalidIndex);
+    Size numPorts = 0;
+    for (Size i=0; i<interface.size(); ++i) {
+        if (interface[i].isValid()) {
+            mapping[i] = numPorts++;
+        }
+    }
+    assert(numPorts == ptr->_numPorts);
+    if (numPorts == interface.size()) {
+        return mapping;
+    }
+
+    internal::remapPorts(ptr, 0, mapping);
+    // Ports of the interface are valid even when disconnected
+    interface.resize(numPorts, internal::Xref::Disconnected());
+    for (internal::Xref& ref : interface) {
+        if (!ref.isValid()) {
+            ref = internal::Xref::Disconnected();
+        }
+    }
+    ptr->_firstFreePort = internal::EmptyInd;
+    ptr->notify(internal::ModuleObserver::PortEdit);
+
+    // Each parent module is updated by a single task
+    parallelForEachModule([&](Module parent) {
+        internal::ModuleImpl* parentPtr = parent.ref()._ptr;
+        bool remapped = false;
+        for (Instance instance : parent.instances()) {
+            if (parentPtr->_nodes[instance.ref()._ind]._instanciation == ptr) {
+                internal::remapPorts(parentPtr, instance.ref()._ind, mapping);
+                remapped = true;
+            }
+        }
+        if (remapped) {
+            parentPtr->touch();
+        }
+    });
+    return mapping;
+}
+
+std::vector<Size> Design::getTeardownOrder() const {
+    // Topological order of the instanciation graph: modules that are not instanciated come first
+    std::vector<Size> numParents(_modules.size(), 0);
+    for (internal::ModuleImpl* module : _modules) {
+        for (Instance instance : Module(module).instances()) {
+            internal::ModuleImpl* down = instance.getDownModule().ref()._ptr;
+            if (down->_design == this) {
+                ++numParents[down->_designId];
+            }
+        }
+    }
+    std::vector<Size> order;
+    for (Size id=0; id<_modules.size(); ++id) {
+        if (numParents[id] == 0) {
+            order.push_back(id);
+        }
+    }
+    for (Size i=0; i<order.size(); ++i) {
+        for (Instance instance : Module(_modules[order[i]]).instances()) {
+            internal::ModuleImpl* down = instance.getDownModule().ref()._ptr;
+            if (down->_design == this && --numParents[down->_designId] == 0) {
+                order.push_back(down->_designId);
+            }
+        }
+    }
+    // Modules on a cycle, in identifier order
+    for (Size id=0; id<_modules.size(); ++id) {
+        if (numParents[id] != 0) {
+            order.push_back(id);
+        }
+    }
+    return order;
+}
+
+} // End namespace gbl
+
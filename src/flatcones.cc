@@ -0,0 +1,167 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl_flatcones.hh"
+#include "gbl_symbols.hh"
+#include "private/gbl_parallel.hh"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+namespace gbl {
+
+namespace {
+// Role of a pin on its net
+const std::uint8_t PinReads  = 1;
+const std::uint8_t PinDrives = 2;
+} // End anonymous namespace
+
+FlatCones::FlatCones(const FlatView& view, const FlatNets& nets)
+: _view(view)
+, _epoch(view.getEpoch())
+, _topIndex(view.getTop().getIndex())
+{
+    // Decoding the pins is the costly part: the arrays are then built from these two
+    const std::vector<FlatSize>& pins = nets.getNetPins();
+    std::vector<FlatSize> pinNodes(pins.size());
+    std::vector<std::uint8_t> pinRoles(pins.size());
+    internal::parallelFor(0, pins.size(), [&](FlatSize i) {
+        FlatModulePort pin = view.getFlatModulePortByIndex(pins[i]);
+        pinNodes[i] = pin.getNode().getIndex();
+        ID dir = pin.getObject().getDirection();
+        // The ports of the top module are seen from the inside
+        ID driving = pin.isTopPort() ? Symbol::DIR_IN : Symbol::DIR_OUT;
+        ID reading = pin.isTopPort() ? Symbol::DIR_OUT : Symbol::DIR_IN;
+        pinRoles[i] = dir == driving ? PinDrives : dir == reading ? PinReads : PinDrives | PinReads;
+    });
+    buildAdjacency(nets, pinNodes, pinRoles, PinDrives, PinReads, view.getNumFlatModules(), _fanOut);
+    buildAdjacency(nets, pinNodes, pinRoles, PinReads, PinDrives, view.getNumFlatModules(), _fanIn);
+}
+
+void FlatCones::buildAdjacency(const FlatNets& nets, const std::vector<FlatSize>& pinNodes, const std::vector<std::uint8_t>& pinRoles,
+                               std::uint8_t fromRole, std::uint8_t toRole, FlatSize numNodes, Adjacency& adj) {
+    FlatSize numNets = nets.getNumNets();
+    const std::vector<FlatSize>& pinOffsets = nets.getNetPinOffsets();
+    // Nodes reached through each net
+    adj._netNodeOffsets.assign(numNets + 1, 0);
+    internal::parallelFor(0, numNets, [&](FlatSize net) {
+        FlatSize count = 0;
+        for (FlatSize i=pinOffsets[net]; i<pinOffsets[net+1]; ++i) {
+            if (pinRoles[i] & toRole) ++count;
+        }
+        adj._netNodeOffsets[net] = count;
+    });
+    FlatSize numNetNodes = internal::parallelExclusiveScan(adj._netNodeOffsets);
+    adj._netNodes.resize(numNetNodes);
+    internal::parallelFor(0, numNets, [&](FlatSize net) {
+        FlatSize pos = adj._netNodeOffsets[net];
+        for (FlatSize i=pinOffsets[net]; i<pinOffsets[net+1]; ++i) {
+            if (pinRoles[i] & toRole) adj._netNodes[pos++] = pinNodes[i];
+        }
+    });
+    // Nets leaving each node
+    adj._nodeNetOffsets.assign(numNodes + 1, 0);
+    for (FlatSize i=0; i<pinNodes.size(); ++i) {
+        if (pinRoles[i] & fromRole) ++adj._nodeNetOffsets[pinNodes[i]];
+    }
+    FlatSize numNodeNets = internal::parallelExclusiveScan(adj._nodeNetOffsets);
+    adj._nodeNets.resize(numNodeNets);
+    std::vector<FlatSize> pos(adj._nodeNetOffsets.begin(), adj._nodeNetOffsets.end() - 1);
+    for (FlatSize net=0; net<numNets; ++net) {
+        for (FlatSize i=pinOffsets[net]; i<pinOffsets[net+1]; ++i) {
+            if (pinRoles[i] & fromRole) adj._nodeNets[pos[pinNodes[i]]++] = net;
+        }
+    }
+}
+
+void FlatCones::traverse(const std::vector<FlatSize>& sources, const std::vector<std::uint64_t>& sourceBits, Direction dir, std::vector<std::uint64_t>& out) const {
+    assert(!isStale());
+    const Adjacency& adj = getAdjacency(dir);
+    FlatSize numNodes = getNumNodes();
+    // Bits that reached each node, and bits that reached it since it was last expanded
+    std::unique_ptr<std::atomic<std::uint64_t>[]> reached(new std::atomic<std::uint64_t>[numNodes]);
+    std::unique_ptr<std::atomic<std::uint64_t>[]> pending(new std::atomic<std::uint64_t>[numNodes]);
+    internal::parallelFor(0, numNodes, [&](FlatSize i) {
+        reached[i].store(0, std::memory_order_relaxed);
+        pending[i].store(0, std::memory_order_relaxed);
+    });
+    std::vector<FlatSize> frontier;
+    std::uint64_t topBits = 0;
+    for (FlatSize i=0; i<sources.size(); ++i) {
+        assert(sources[i] < numNodes);
+        reached[sources[i]].fetch_or(sourceBits[i], std::memory_order_relaxed);
+        if (pending[sources[i]].fetch_or(sourceBits[i], std::memory_order_relaxed) == 0) {
+            frontier.push_back(sources[i]);
+        }
+        if (sources[i] == _topIndex) {
+            topBits |= sourceBits[i];
+        }
+    }
+    // Each node enters the next frontier once per level, when its pending bits become non-zero
+    std::vector<FlatSize> next(numNodes);
+    std::vector<std::uint64_t> frontierBits;
+    while (!frontier.empty()) {
+        frontierBits.resize(frontier.size());
+        internal::parallelFor(0, frontier.size(), [&](FlatSize i) {
+            frontierBits[i] = pending[frontier[i]].exchange(0, std::memory_order_relaxed);
+        });
+        std::atomic<FlatSize> numNext(0);
+        internal::parallelFor(0, frontier.size(), [&](FlatSize i) {
+            FlatSize node = frontier[i];
+            std::uint64_t bits = node == _topIndex ? frontierBits[i] & topBits : frontierBits[i];
+            if (bits == 0) return;
+            for (FlatSize j=adj._nodeNetOffsets[node]; j<adj._nodeNetOffsets[node+1]; ++j) {
+                FlatSize net = adj._nodeNets[j];
+                for (FlatSize k=adj._netNodeOffsets[net]; k<adj._netNodeOffsets[net+1]; ++k) {
+                    FlatSize succ = adj._netNodes[k];
+                    // Cheap check first: most visits in a large cone find nothing new
+                    if ((reached[succ].load(std::memory_order_relaxed) & bits) == bits) continue;
+                    std::uint64_t added = bits & ~reached[succ].fetch_or(bits, std::memory_order_relaxed);
+                    if (added != 0 && pending[succ].fetch_or(added, std::memory_order_relaxed) == 0) {
+                        next[numNext++] = succ;
+                    }
+                }
+            }
+        });
+        frontier.assign(next.begin(), next.begin() + numNext.load());
+    }
+    out.resize(numNodes);
+    internal::parallelFor(0, numNodes, [&](FlatSize i) {
+        out[i] = reached[i].load(std::memory_order_relaxed);
+    });
+}
+
+void FlatCones::propagate(const std::vector<FlatSize>& sources, Direction dir, std::vector<std::uint64_t>& out) const {
+    assert(sources.size() <= 64);
+    std::vector<std::uint64_t> sourceBits(sources.size());
+    for (Size i=0; i<sources.size(); ++i) {
+        sourceBits[i] = std::uint64_t(1) << i;
+    }
+    traverse(sources, sourceBits, dir, out);
+}
+
+void FlatCones::getCone(const std::vector<FlatSize>& sources, Direction dir, std::vector<FlatSize>& out) const {
+    std::vector<std::uint64_t> reached;
+    traverse(sources, std::vector<std::uint64_t>(sources.size(), 1), dir, reached);
+    out.clear();
+    for (FlatSize i=0; i<reached.size(); ++i) {
+        if (reached[i] != 0) out.push_back(i);
+    }
+}
+
+void FlatCones::getCones(const std::vector<FlatSize>& sources, Direction dir, std::vector<std::vector<FlatSize> >& out) const {
+    out.assign(sources.size(), std::vector<FlatSize>());
+    std::vector<std::uint64_t> reached;
+    for (FlatSize begin=0; begin<sources.size(); begin+=64) {
+        FlatSize end = std::min<FlatSize>(begin + 64, sources.size());
+        propagate(std::vector<FlatSize>(sources.begin() + begin, sources.begin() + end), dir, reached);
+        for (FlatSize i=0; i<reached.size(); ++i) {
+            for (std::uint64_t bits = reached[i]; bits != 0; bits &= bits - 1) {
+                out[begin + __builtin_ctzll(bits)].push_back(i);
+            }
+        }
+    }
+}
+
+} // End namespace gbl
+
@@ -0,0 +1,132 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl_flatnets.hh"
+#include "private/gbl_parallel.hh"
+
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+namespace gbl {
+
+namespace {
+// Concurrent union-find: each set is represented by its smallest element, so that the result doesn't depend on the order of the unions
+class UnionFind {
+  public:
+  explicit UnionFind(FlatSize size)
+  : _parents(new std::atomic<FlatSize>[size])
+  {
+      internal::parallelFor(0, size, [&](FlatSize i) {
+          _parents[i].store(i, std::memory_order_relaxed);
+      });
+  }
+
+  FlatSize find(FlatSize i) {
+      while (true) {
+          FlatSize parent = _parents[i].load(std::memory_order_relaxed);
+          if (parent == i) {
+              return i;
+          }
+          // Path halving; a failed update is harmless
+          FlatSize grandParent = _parents[parent].load(std::memory_order_relaxed);
+          _parents[i].compare_exchange_weak(parent, grandParent, std::memory_order_relaxed);
+          i = grandParent;
+      }
+  }
+
+  void unite(FlatSize a, FlatSize b) {
+      while (true) {
+          a = find(a);
+          b = find(b);
+          if (a == b) {
+              return;
+          }
+          // Link the larger root under the smaller one
+          if (a < b) {
+              std::swap(a, b);
+          }
+          FlatSize expected = a;
+          if (_parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+              return;
+          }
+      }
+  }
+
+  private:
+  std::unique_ptr<std::atomic<FlatSize>[]> _parents;
+};
+} // End anonymous namespace
+
+FlatNets::FlatNets(const FlatView& view)
+: _view(view)
+, _epoch(view.getEpoch())
+{
+    FlatSize numWires = view.getNumFlatWires();
+    FlatSize numPorts = view.getNumFlatPorts();
+
+    // Join the wires on both sides of each port, and record the wire of each pin
+    UnionFind sets(numWires);
+    _pinNets.assign(numPorts, InvalidFlatIndex);
+    internal::parallelFor(0, numPorts, [&](FlatSize i) {
+        FlatModulePort port = view.getFlatModulePortByIndex(i);
+        bool isTop = port.isTopPort();
+        FlatSize inner = port.getObject().isConnected() ? port.getWire().getIndex() : InvalidFlatIndex;
+        if (isTop) {
+            _pinNets[i] = inner;
+            return;
+        }
+        FlatInstancePort upPort = port.getUpPort();
+        FlatSize outer = upPort.getObject().isConnected() ? upPort.getWire().getIndex() : InvalidFlatIndex;
+        if (port.getObject().ref()._ptr->_leaf) {
+            _pinNets[i] = outer;
+        }
+        else if (inner != InvalidFlatIndex && outer != InvalidFlatIndex) {
+            sets.unite(inner, outer);
+        }
+    });
+
+    // Dense numbering of the roots
+    std::vector<FlatSize> netIds(numWires);
+    _wireNets.resize(numWires);
+    internal::parallelFor(0, numWires, [&](FlatSize i) {
+        _wireNets[i] = sets.find(i);
+        netIds[i] = _wireNets[i] == i ? 1 : 0;
+    });
+    FlatSize numNets = internal::parallelExclusiveScan(netIds);
+    internal::parallelFor(0, numWires, [&](FlatSize i) {
+        _wireNets[i] = netIds[_wireNets[i]];
+    });
+
+    // Pins of each net, sorted so that the result doesn't depend on the scheduling
+    std::unique_ptr<std::atomic<FlatSize>[]> counts(new std::atomic<FlatSize>[numNets]);
+    internal::parallelFor(0, numNets, [&](FlatSize net) {
+        counts[net].store(0, std::memory_order_relaxed);
+    });
+    internal::parallelFor(0, numPorts, [&](FlatSize i) {
+        if (_pinNets[i] != InvalidFlatIndex) {
+            _pinNets[i] = _wireNets[_pinNets[i]];
+            counts[_pinNets[i]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    _netPinOffsets.resize(numNets + 1);
+    internal::parallelFor(0, numNets, [&](FlatSize net) {
+        _netPinOffsets[net] = counts[net].load(std::memory_order_relaxed);
+    });
+    _netPinOffsets[numNets] = 0;
+    FlatSize numPins = internal::parallelExclusiveScan(_netPinOffsets);
+    _netPins.resize(numPins);
+    internal::parallelFor(0, numNets, [&](FlatSize net) {
+        counts[net].store(_netPinOffsets[net], std::memory_order_relaxed);
+    });
+    internal::parallelFor(0, numPorts, [&](FlatSize i) {
+        if (_pinNets[i] != InvalidFlatIndex) {
+            _netPins[counts[_pinNets[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+        }
+    });
+    internal::parallelFor(0, numNets, [&](FlatSize net) {
+        std::sort(_netPins.begin() + _netPinOffsets[net], _netPins.begin() + _netPinOffsets[net+1]);
+    });
+}
+
+} // End namespace gbl
+
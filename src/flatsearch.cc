@@ -0,0 +1,114 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl_flatsearch.hh"
+
+#include <algorithm>
+
+namespace gbl {
+
+namespace {
+// Symbols of a module's own objects, merged with the summaries of the modules it instanciates
+SubtreeSymbols summarizeSymbols(Module module, const ModuleSummaries<SubtreeSymbols>& summaries) {
+    std::vector<ID> names, properties;
+    auto addData = [&](Names objNames, Properties objProperties) {
+        names.insert(names.end(), objNames.begin(), objNames.end());
+        properties.insert(properties.end(), objProperties.begin(), objProperties.end());
+    };
+    addData(module.names(), module.properties());
+    for (ModulePort port : module.ports()) {
+        addData(port.names(), port.properties());
+    }
+    for (Wire wire : module.wires()) {
+        addData(wire.names(), wire.properties());
+    }
+    // Each child module is merged once, whatever its number of instances
+    std::vector<const SubtreeSymbols*> children;
+    for (Instance inst : module.instances()) {
+        addData(inst.names(), inst.properties());
+        for (InstancePort port : inst.ports()) {
+            addData(port.names(), port.properties());
+        }
+        children.push_back(&summaries.getChild(inst.getDownModule()));
+    }
+    std::sort(children.begin(), children.end());
+    children.erase(std::unique(children.begin(), children.end()), children.end());
+    for (const SubtreeSymbols* child : children) {
+        names.insert(names.end(), child->_names.getIds().begin(), child->_names.getIds().end());
+        properties.insert(properties.end(), child->_properties.getIds().begin(), child->_properties.getIds().end());
+    }
+    SubtreeSymbols ret;
+    ret._names.assign(names);
+    ret._properties.assign(properties);
+    return ret;
+}
+} // End anonymous namespace
+
+void SymbolSet::assign(std::vector<ID>& ids) {
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    ids.shrink_to_fit();
+    _ids.swap(ids);
+}
+
+bool SymbolSet::contains(ID id) const {
+    return std::binary_search(_ids.begin(), _ids.end(), id);
+}
+
+FlatSearch::FlatSearch(const FlatView& view)
+: _view(view)
+, _summaries(summarizeSymbols)
+, _numVisited(0)
+{
+}
+
+void FlatSearch::findInstancesWithName(ID id, std::vector<FlatSize>& out) {
+    find(id, true, false, out);
+}
+
+void FlatSearch::findInstancesWithProperty(ID id, std::vector<FlatSize>& out) {
+    find(id, false, false, out);
+}
+
+void FlatSearch::findWiresWithName(ID id, std::vector<FlatSize>& out) {
+    find(id, true, true, out);
+}
+
+void FlatSearch::findWiresWithProperty(ID id, std::vector<FlatSize>& out) {
+    find(id, false, true, out);
+}
+
+void FlatSearch::find(ID id, bool isName, bool wires, std::vector<FlatSize>& out) {
+    out.clear();
+    _numVisited = 0;
+    if (_view.hasCycle()) {
+        return;
+    }
+    // Brings the summaries of the whole hierarchy up to date once
+    const SubtreeSymbols& top = *_summaries.get(_view.getTop().getObject());
+    if ((isName ? top._names : top._properties).contains(id)) {
+        find(_view.getTop(), id, isName, wires, out);
+    }
+}
+
+void FlatSearch::find(FlatModule module, ID id, bool isName, bool wires, std::vector<FlatSize>& out) {
+    ++_numVisited;
+    if (wires) {
+        for (FlatWire wire : module.wires()) {
+            if (isName ? wire.hasName(id) : wire.hasProperty(id)) {
+                out.push_back(wire.getIndex());
+            }
+        }
+    }
+    for (FlatInstance inst : module.instances()) {
+        if (!wires && (isName ? inst.hasName(id) : inst.hasProperty(id))) {
+            out.push_back(inst.getIndex());
+        }
+        const SubtreeSymbols& child = _summaries.getChild(inst.getObject().getDownModule());
+        if ((isName ? child._names : child._properties).contains(id)) {
+            find(inst.getDownModule(), id, isName, wires, out);
+        }
+    }
+}
+
+} // End namespace gbl
+
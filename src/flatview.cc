@@ -1,117 +1,691 @@
 // Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
 
 #include "gbl_flatview.hh"
+#include "gbl_hierarchy.hh"
+#include "private/gbl_parallel.hh"
 
-#include <unordered_set>
+#include <unordered_map>
 
 namespace gbl {
 
-namespace { // Helpers
-void visitModule(Module module, std::vector<internal::ModuleImpl*>& moduleOrder, std::unordered_set<internal::ModuleImpl*>& visited) {
-    // Will ignore loops awkwardly for now; we could just error out if loops are present
-    visited.insert(module.ref()._ptr);
-    for (Instance instance : module.instances()) {
-        Module downModule = instance.getDownModule();
-        if (visited.count(downModule.ref()._ptr) == 0) {
-            visitModule(downModule, moduleOrder, visited);
+FlatView::FlatView(Module topModule, bool lazy)
+: _topMod(topModule)
+, _lazy(lazy)
+, _dirty(false)
+, _hierarchyDirty(false)
+, _cyclic(false)
+, _numRenumbered(0)
+, _epoch(0)
+{
+    rebuildHierarchy();
+    // A cyclic view is rebuilt by each query until the cycle is broken
+    _hierarchyDirty = _cyclic;
+    _dirty.store(_cyclic, std::memory_order_release);
+    selfcheck();
+}
+
+FlatView::~FlatView() {
+    for (internal::ModuleImpl* module : _mods) {
+        if (module != nullptr) {
+            module->unsubscribe(this);
         }
     }
-    moduleOrder.push_back(module.ref()._ptr);
 }
-} // End anonymous namespace
 
-FlatView::FlatView(Module topModule)
-: _topMod(topModule)
-{
-    using namespace std;
-    // Deterministic topological traversal from top
-    std::unordered_set<internal::ModuleImpl*> visitedSet;
-    visitModule(_topMod, _mods, visitedSet);
-    std::reverse(_mods.begin(), _mods.end());
-
-    _parents.resize(_mods.size());
-    _children.resize(_mods.size());
-    _wires.resize(_mods.size());
-    _ports.resize(_mods.size());
-    _wireHierToInternal.resize(_mods.size());
-    _portHierToInternal.resize(_mods.size());
-
-    // Create structure for module to index translation
+void FlatView::notifyEdit(internal::ModuleImpl* module, EditType edit, Size index) const {
+    assert(module->_id < _id2Index.size());
+    Size modIndex = _id2Index[module->_id];
+    assert(modIndex < _mods.size() && _mods[modIndex] == module);
+    switch (edit) {
+      case WireEdit:
+      case PortEdit:
+        _tablesDirty[modIndex] = true;
+        break;
+      case InstanceEdit:
+        if (index == InvalidIndex) {
+            _instancesDirty[modIndex] = true;
+        }
+        else {
+            _editedInstances[modIndex].push_back(index);
+        }
+        _hierarchyDirty = true;
+        break;
+      case Destruction:
+        // No longer instanciated in the hierarchy, and shouldn't be unsubscribed from
+        _mods[modIndex] = nullptr;
+        _id2Index[module->_id] = InvalidIndex;
+        _hierarchyDirty = true;
+        break;
+    }
+    _dirty.store(true, std::memory_order_release);
+}
+
+void FlatView::update() {
+    applyEdits();
+}
+
+void FlatView::applyEdits() const {
+    std::lock_guard<std::mutex> guard(_updateLock);
+    if (!_dirty.load(std::memory_order_acquire)) {
+        return;
+    }
+    bool wasCyclic = _cyclic;
+    bool rebuilt = false;
+    _numRenumbered = 0;
+    if (_hierarchyDirty) {
+        // Follow the instance edits, except in the modules that are scanned again anyway
+        std::vector<InstanceChange> changes;
+        bool rescan = _cyclic;
+        for (Size i=0; i<_mods.size(); ++i) {
+            if (_mods[i] == nullptr || _instancesDirty[i]) {
+                _editedInstances[i].clear();
+                rescan = true;
+            }
+            else {
+                patchInstances(i, changes);
+            }
+        }
+        if (rescan || !hasSameOrder()) {
+            rebuildHierarchy();
+            rebuilt = true;
+        }
+        else {
+            renumberHierarchy(changes);
+        }
+    }
+    if (!rebuilt) {
+        // Same modules: only the edited tables and the global numbering change
+        std::vector<Size> toBuild;
+        for (Size i=0; i<_mods.size(); ++i) {
+            if (_tablesDirty[i]) {
+                toBuild.push_back(i);
+            }
+        }
+        internal::parallelFor(0, toBuild.size(), [&](Size i) {
+            invalidateTables(toBuild[i]);
+        });
+        _tablesDirty.assign(_mods.size(), false);
+        buildEndIndexes();
+    }
+    // An empty view that is still cyclic was not renumbered
+    if (!wasCyclic || !_cyclic) {
+        ++_epoch;
+    }
+    _hierarchyDirty = _cyclic;
+    _dirty.store(_cyclic, std::memory_order_release);
+#ifndef NDEBUG
+    selfcheck();
+#endif
+}
+
+void FlatView::rebuildHierarchy() const {
+    // The previous state, whose unchanged modules are reused
+    std::vector<internal::ModuleImpl*> oldMods;
+    std::vector<Size> oldId2Index;
+    std::vector<std::vector<internal::ModuleImpl*> > oldInstances;
+    std::vector<std::vector<ChildCount> > oldChildCounts;
+    std::vector<std::vector<Size> > oldWires, oldWireHierToInternal, oldPorts, oldPortHierToInternal;
+    std::vector<char> oldInstancesDirty, oldTablesDirty;
+    std::unique_ptr<std::atomic<bool>[]> oldMaterialized(std::move(_materialized));
+    oldMods.swap(_mods);
+    oldId2Index.swap(_id2Index);
+    oldInstances.swap(_instances);
+    oldChildCounts.swap(_childCounts);
+    _editedInstances.clear();
+    oldWires.swap(_wires);
+    oldWireHierToInternal.swap(_wireHierToInternal);
+    oldPorts.swap(_ports);
+    oldPortHierToInternal.swap(_portHierToInternal);
+    oldInstancesDirty.swap(_instancesDirty);
+    oldTablesDirty.swap(_tablesDirty);
+
+    auto getOldIndex = [&](internal::ModuleImpl* module) -> Size {
+        if (module->_id >= oldId2Index.size()) return InvalidIndex;
+        Size ind = oldId2Index[module->_id];
+        return ind != InvalidIndex && oldMods[ind] == module ? ind : InvalidIndex;
+    };
+
+    // Deterministic topological order from top, shared with the other views of the hierarchy
+    std::shared_ptr<const HierarchyOrder> order = HierarchyOrder::get(_topMod);
+    _cyclic = !order->isAcyclic();
+    if (_cyclic) {
+        // No flat numbering: the view is empty, and doesn't need to know about the edits
+        for (internal::ModuleImpl* module : oldMods) {
+            if (module != nullptr) {
+                module->unsubscribe(this);
+            }
+        }
+        _parents.clear();
+        _children.clear();
+        _modEndIndexs.assign(1, 0);
+        _wireEndIndexs.assign(1, 0);
+        _portEndIndexs.assign(1, 0);
+        _numInstDividers.clear();
+        return;
+    }
+    _mods = order->_mods;
+    _id2Index = order->_id2Index;
+
+    Size numMods = _mods.size();
+    _instances.resize(numMods);
+    _childCounts.resize(numMods);
+    _editedInstances.resize(numMods);
+    _wires.resize(numMods);
+    _ports.resize(numMods);
+    _wireHierToInternal.resize(numMods);
+    _portHierToInternal.resize(numMods);
+    _materialized.reset(new std::atomic<bool>[numMods]);
+
+    // Reuse what is still valid, and subscribe to the new modules
+    std::vector<Size> toCollect, toBuild;
+    std::vector<char> kept(oldMods.size(), false);
+    for (Size i=0; i<numMods; ++i) {
+        Size oldIndex = getOldIndex(_mods[i]);
+        if (oldIndex == InvalidIndex) {
+            _mods[i]->subscribe(this);
+            toCollect.push_back(i);
+            toBuild.push_back(i);
+            continue;
+        }
+        kept[oldIndex] = true;
+        if (oldInstancesDirty[oldIndex]) {
+            toCollect.push_back(i);
+        }
+        else {
+            _instances[i].swap(oldInstances[oldIndex]);
+            _childCounts[i].swap(oldChildCounts[oldIndex]);
+        }
+        if (oldTablesDirty[oldIndex]) {
+            toBuild.push_back(i);
+        }
+        else {
+            _wires[i].swap(oldWires[oldIndex]);
+            _wireHierToInternal[i].swap(oldWireHierToInternal[oldIndex]);
+            _ports[i].swap(oldPorts[oldIndex]);
+            _portHierToInternal[i].swap(oldPortHierToInternal[oldIndex]);
+            _materialized[i].store(oldMaterialized[oldIndex].load());
+        }
+    }
+    for (Size i=0; i<oldMods.size(); ++i) {
+        if (!kept[i] && oldMods[i] != nullptr) {
+            oldMods[i]->unsubscribe(this);
+        }
+    }
+    _instancesDirty.assign(numMods, false);
+    _tablesDirty.assign(numMods, false);
+
+    // The instances and tables of each module are independent
+    internal::parallelFor(0, toCollect.size(), [&](Size i) {
+        collectInstances(toCollect[i]);
+    });
+    internal::parallelFor(0, toBuild.size(), [&](Size i) {
+        invalidateTables(toBuild[i]);
+    });
+
+    buildHierarchy();
+    buildEndIndexes();
+}
+
+void FlatView::collectInstances(Size modIndex) const {
+    internal::ModuleImpl* module = _mods[modIndex];
+    std::vector<internal::ModuleImpl*>& instances = _instances[modIndex];
+    std::vector<ChildCount>& childCounts = _childCounts[modIndex];
+    instances.assign(module->_nodes.size(), nullptr);
+    childCounts.clear();
+    // Position of each child in the counts; consecutive instances often share their module
+    std::unordered_map<internal::ModuleImpl*, Size> childPositions;
+    internal::ModuleImpl* lastModule = nullptr;
+    Size lastPosition = InvalidIndex;
+    for (Instance instance : Module(module).instances()) {
+        Size instIndex = instance.ref()._ind;
+        internal::ModuleImpl* downModule = instance.getDownModule().ref()._ptr;
+        instances[instIndex] = downModule;
+        if (downModule != lastModule) {
+            std::pair<std::unordered_map<internal::ModuleImpl*, Size>::iterator, bool> res = childPositions.emplace(downModule, childCounts.size());
+            if (res.second) {
+                childCounts.emplace_back(downModule, 0, instIndex);
+            }
+            lastModule = downModule;
+            lastPosition = res.first->second;
+        }
+        ++childCounts[lastPosition]._count;
+    }
+}
+
+void FlatView::patchInstances(Size modIndex, std::vector<InstanceChange>& changes) const {
+    std::vector<Size>& edited = _editedInstances[modIndex];
+    std::sort(edited.begin(), edited.end());
+    edited.erase(std::unique(edited.begin(), edited.end()), edited.end());
+    internal::ModuleImpl* module = _mods[modIndex];
+    std::vector<internal::ModuleImpl*>& instances = _instances[modIndex];
+    for (Size instIndex : edited) {
+        internal::ModuleImpl* oldModule = instIndex < instances.size() ? instances[instIndex] : nullptr;
+        internal::ModuleImpl* newModule = module->_nodes.isValid(instIndex) ? module->_nodes[instIndex]._instanciation : nullptr;
+        // Destroyed and created again since the last update
+        if (oldModule == newModule) {
+            continue;
+        }
+        if (instIndex >= instances.size()) {
+            instances.resize(instIndex + 1, nullptr);
+        }
+        instances[instIndex] = newModule;
+        if (oldModule != nullptr) {
+            removeChild(modIndex, oldModule, instIndex);
+        }
+        if (newModule != nullptr) {
+            addChild(modIndex, newModule, instIndex);
+        }
+        changes.emplace_back(modIndex, instIndex, oldModule, newModule);
+    }
+    edited.clear();
+}
+
+void FlatView::addChild(Size modIndex, internal::ModuleImpl* downModule, Size instIndex) const {
+    std::vector<ChildCount>& childCounts = _childCounts[modIndex];
+    std::vector<ChildCount>::iterator it = std::find_if(childCounts.begin(), childCounts.end(),
+        [downModule](const ChildCount& child) { return child._downModule == downModule; });
+    if (it == childCounts.end()) {
+        childCounts.emplace_back(downModule, 1, instIndex);
+        it = childCounts.end() - 1;
+    }
+    else {
+        ++it->_count;
+        if (instIndex > it->_first) {
+            return;
+        }
+        it->_first = instIndex;
+    }
+    // Keep the order of first instanciation
+    while (it != childCounts.begin() && (it-1)->_first > it->_first) {
+        std::iter_swap(it-1, it);
+        --it;
+    }
+}
+
+void FlatView::removeChild(Size modIndex, internal::ModuleImpl* downModule, Size instIndex) const {
+    std::vector<ChildCount>& childCounts = _childCounts[modIndex];
+    std::vector<ChildCount>::iterator it = std::find_if(childCounts.begin(), childCounts.end(),
+        [downModule](const ChildCount& child) { return child._downModule == downModule; });
+    assert(it != childCounts.end() && it->_count > 0);
+    if (--it->_count == 0) {
+        childCounts.erase(it);
+        return;
+    }
+    if (it->_first != instIndex) {
+        return;
+    }
+    // The counts follow _instances, that holds another instance of the module after this one
+    const std::vector<internal::ModuleImpl*>& instances = _instances[modIndex];
+    Size first = instIndex + 1;
+    while (instances[first] != downModule) {
+        ++first;
+    }
+    it->_first = first;
+    while (it+1 != childCounts.end() && (it+1)->_first < it->_first) {
+        std::iter_swap(it, it+1);
+        ++it;
+    }
+}
+
+bool FlatView::hasSameOrder() const {
+    // Same traversal as HierarchyOrder, on the counts instead of the instances
+    Size numMods = _mods.size();
+    enum State : char { Unvisited, InProgress, Done };
+    std::vector<char> states(numMods, Unvisited);
+    // Module index and next child
+    std::vector<std::pair<Size, Size> > stack;
+    std::vector<Size> postOrder;
+    states[0] = InProgress;
+    stack.emplace_back(0, 0);
+    while (!stack.empty()) {
+        Size modIndex = stack.back().first;
+        const std::vector<ChildCount>& children = _childCounts[modIndex];
+        if (stack.back().second == children.size()) {
+            states[modIndex] = Done;
+            postOrder.push_back(modIndex);
+            stack.pop_back();
+            continue;
+        }
+        internal::ModuleImpl* child = children[stack.back().second++]._downModule;
+        Size childIndex = child->_id < _id2Index.size() ? _id2Index[child->_id] : InvalidIndex;
+        // A new module, or a cycle
+        if (childIndex == InvalidIndex || _mods[childIndex] != child || states[childIndex] == InProgress) {
+            return false;
+        }
+        if (states[childIndex] == Unvisited) {
+            states[childIndex] = InProgress;
+            stack.emplace_back(childIndex, 0);
+        }
+    }
+    // Reverse postorder, and no module left out
+    if (postOrder.size() != numMods) {
+        return false;
+    }
+    for (Size i=0; i<numMods; ++i) {
+        if (postOrder[numMods-1-i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FlatView::renumberHierarchy(const std::vector<InstanceChange>& changes) const {
+    Size numMods = _mods.size();
+
+    // New flat counts, from the number of instances of each child
+    std::vector<FlatSize> flatSizes(numMods, 0);
+    flatSizes[0] = 1;
+    for (Size i=0; i<numMods; ++i) {
+        for (const ChildCount& child : _childCounts[i]) {
+            flatSizes[_id2Index[child._downModule->_id]] += flatSizes[i] * child._count;
+        }
+    }
+
+    // Parent instances of a module, ordered like _parents by module index then instance index
+    typedef std::pair<Size, Size> ParentKey;
+    struct ParentEdits {
+        std::vector<ParentKey> _removed;
+        std::vector<ParentKey> _inserted;
+        // Parent modules whose flat count changed
+        std::vector<Size>      _resized;
+    };
+    std::vector<ParentEdits> edits(numMods);
+    std::vector<char> affected(numMods, false);
+    for (const InstanceChange& change : changes) {
+        ParentKey key(change._modIndex, change._instIndex);
+        if (change._oldModule != nullptr) {
+            Size downModIndex = _id2Index[change._oldModule->_id];
+            edits[downModIndex]._removed.push_back(key);
+            affected[downModIndex] = true;
+            setDownInfo(change._modIndex, change._instIndex, DownInfo(InvalidFlatIndex, InvalidIndex));
+        }
+        if (change._newModule != nullptr) {
+            Size downModIndex = _id2Index[change._newModule->_id];
+            edits[downModIndex]._inserted.push_back(key);
+            affected[downModIndex] = true;
+        }
+    }
+    for (Size i=0; i<numMods; ++i) {
+        if (flatSizes[i] == getNumFlatInstanciations(i)) {
+            continue;
+        }
+        for (const ChildCount& child : _childCounts[i]) {
+            Size downModIndex = _id2Index[child._downModule->_id];
+            edits[downModIndex]._resized.push_back(i);
+            affected[downModIndex] = true;
+        }
+    }
+
+    // Renumber the parent instances of the affected modules, from the first one that changed
+    auto keyLess = [](const UpInfo& info, const ParentKey& key) {
+        Instance instance = info._parentInstance;
+        return ParentKey(info._parentModIndex, instance.ref()._ind) < key;
+    };
+    for (Size modIndex=1; modIndex<numMods; ++modIndex) {
+        if (!affected[modIndex]) {
+            continue;
+        }
+        ++_numRenumbered;
+        ParentEdits& edit = edits[modIndex];
+        ParentInfos& parents = _parents[modIndex];
+        std::sort(edit._removed.begin(), edit._removed.end());
+        std::sort(edit._inserted.begin(), edit._inserted.end());
+        std::vector<ParentKey> starts;
+        if (!edit._removed.empty()) starts.push_back(edit._removed.front());
+        if (!edit._inserted.empty()) starts.push_back(edit._inserted.front());
+        if (!edit._resized.empty()) starts.push_back(ParentKey(edit._resized.front(), 0));
+        Size start = std::lower_bound(parents._upInfos.begin(), parents._upInfos.end(), *std::min_element(starts.begin(), starts.end()), keyLess)
+                   - parents._upInfos.begin();
+
+        std::vector<UpInfo> suffix(parents._upInfos.begin() + start, parents._upInfos.end());
+        parents._upInfos.erase(parents._upInfos.begin() + start, parents._upInfos.end());
+        parents._instEndIndexs.resize(start + 1);
+        auto append = [&](Size parentModIndex, Instance instance) {
+            FlatSize offset = parents._instEndIndexs.back();
+            parents._instEndIndexs.push_back(offset + flatSizes[parentModIndex]);
+            parents._upInfos.emplace_back(instance, parentModIndex, offset);
+            setDownInfo(parentModIndex, instance.ref()._ind, DownInfo(offset, modIndex));
+        };
+        std::vector<ParentKey>::const_iterator inserted = edit._inserted.begin();
+        std::vector<ParentKey>::const_iterator removed = edit._removed.begin();
+        for (const UpInfo& info : suffix) {
+            Instance instance = info._parentInstance;
+            ParentKey key(info._parentModIndex, instance.ref()._ind);
+            for (; inserted != edit._inserted.end() && *inserted < key; ++inserted) {
+                append(inserted->first, Instance(Node(_mods[inserted->first], inserted->second)));
+            }
+            if (removed != edit._removed.end() && *removed == key) {
+                ++removed;
+                continue;
+            }
+            append(info._parentModIndex, instance);
+        }
+        for (; inserted != edit._inserted.end(); ++inserted) {
+            append(inserted->first, Instance(Node(_mods[inserted->first], inserted->second)));
+        }
+        assert(removed == edit._removed.end());
+    }
+
+    _modEndIndexs.assign(1, 0);
+    for (Size i=0; i<numMods; ++i) {
+        _modEndIndexs.push_back(_modEndIndexs.back() + flatSizes[i]);
+    }
+}
+
+void FlatView::setDownInfo(Size modIndex, Size instIndex, DownInfo info) const {
+    std::vector<DownInfo>& downInfos = _children[modIndex]._downInfos;
+    // Handle holes in the instance list
+    if (downInfos.size() <= instIndex) {
+        downInfos.resize(instIndex + 1, DownInfo(InvalidFlatIndex, InvalidIndex));
+    }
+    downInfos[instIndex] = info;
+}
+
+void FlatView::buildTables(Size modIndex) const {
+    Module module(_mods[modIndex]);
+    std::vector<Size>& wires = _wires[modIndex];
+    std::vector<Size>& wireHierToInternal = _wireHierToInternal[modIndex];
+    std::vector<Size>& ports = _ports[modIndex];
+    std::vector<Size>& portHierToInternal = _portHierToInternal[modIndex];
+    wires.clear();
+    wireHierToInternal.clear();
+    ports.clear();
+    portHierToInternal.clear();
+    for (Wire wire : module.wires()) {
+        wires.push_back(wire.ref()._ind);
+        while (wireHierToInternal.size() < wire.ref()._ind) {
+            wireHierToInternal.push_back(InvalidIndex);
+        }
+        wireHierToInternal.push_back(wires.size()-1);
+        assert(wireHierToInternal.size() == wire.ref()._ind + 1);
+    }
+    for (Port port : module.ports()) {
+        ports.push_back(port.ref()._portInd);
+        while (portHierToInternal.size() < port.ref()._portInd) {
+            portHierToInternal.push_back(InvalidIndex);
+        }
+        portHierToInternal.push_back(ports.size()-1);
+        assert(portHierToInternal.size() == port.ref()._portInd + 1);
+    }
+}
+
+void FlatView::invalidateTables(Size modIndex) const {
+    if (_lazy) {
+        _wires[modIndex].clear();
+        _wireHierToInternal[modIndex].clear();
+        _ports[modIndex].clear();
+        _portHierToInternal[modIndex].clear();
+        _materialized[modIndex].store(false);
+    }
+    else {
+        buildTables(modIndex);
+        _materialized[modIndex].store(true);
+    }
+}
+
+void FlatView::materializeSlow(Size modIndex) const {
+    std::lock_guard<std::mutex> guard(_materializeLock);
+    if (_materialized[modIndex].load(std::memory_order_relaxed)) {
+        return;
+    }
+    buildTables(modIndex);
+    _materialized[modIndex].store(true, std::memory_order_release);
+}
+
+Size FlatView::getNumRenumberedModules() const {
+    sync();
+    return _numRenumbered;
+}
+
+Size FlatView::getNumMaterializedModules() const {
+    sync();
+    Size ret = 0;
     for (Size i=0; i<_mods.size(); ++i) {
-        _mod2Index[_mods[i]] = i;
+        if (_materialized[i].load()) {
+            ++ret;
+        }
     }
+    return ret;
+}
+
+void FlatView::buildHierarchy() const {
+    Size numMods = _mods.size();
 
     // Size of the flat indexing range for each module
-    std::vector<FlatSize> flatSizes(_mods.size(), 0);
+    std::vector<FlatSize> flatSizes(numMods, 0);
     // The top module has exactly one instanciation
     flatSizes[0] = 1;
     // First flat index of the top module is 0
-    _modEndIndexs.push_back(0);
+    _modEndIndexs.assign(1, 0);
 
-    for (Size i=0; i<_mods.size(); ++i) {
-        Module module(_mods[i]);
+    for (Size i=0; i<numMods; ++i) {
         FlatSize fsize = flatSizes[i];
         assert(fsize > 0);
-        for (Instance instance : module.instances()) {
-            Size downModIndex = _mod2Index[instance.getDownModule().ref()._ptr];
+        for (const ChildCount& child : _childCounts[i]) {
+            Size downModIndex = _id2Index[child._downModule->_id];
             assert(downModIndex > i);
-            flatSizes[downModIndex] += fsize;
+            flatSizes[downModIndex] += fsize * child._count;
         }
         _modEndIndexs.push_back(fsize + _modEndIndexs.back());
     }
 
     // Init each parent/child couple
-    for (Size i=0; i<_mods.size(); ++i) {
+    _parents.assign(numMods, ParentInfos());
+    _children.assign(numMods, ChildInfos());
+    for (Size i=0; i<numMods; ++i) {
         _parents[i]._instEndIndexs.push_back(0);
     }
-    for (Size modIndex=0; modIndex<_mods.size(); ++modIndex) {
-        Module module(_mods[modIndex]);
-        _children[modIndex]._downInfos.emplace_back(0); // For the module, which is the node of _ind 0
-        for (Instance instance : module.instances()) {
-            Size instIndex = instance.ref()._ind;
-            Size downModIndex = _mod2Index[instance.getDownModule().ref()._ptr];
+    for (Size modIndex=0; modIndex<numMods; ++modIndex) {
+        _children[modIndex]._downInfos.emplace_back(0, modIndex); // For the module, which is the node of _ind 0
+        const std::vector<internal::ModuleImpl*>& instances = _instances[modIndex];
+        for (Size instIndex=0; instIndex<instances.size(); ++instIndex) {
+            if (instances[instIndex] == nullptr) {
+                continue;
+            }
+            Size downModIndex = _id2Index[instances[instIndex]->_id];
 
             std::vector<FlatSize>& instIndexs = _parents[downModIndex]._instEndIndexs;
             FlatSize offset = instIndexs.back();
             instIndexs.push_back(instIndexs.back() + flatSizes[modIndex]);
 
-            _parents[downModIndex]._upInfos.emplace_back(instance, offset);
-            // Handle holes in the instance list
-            while(_children[modIndex]._downInfos.size() < instIndex) {
-                _children[modIndex]._downInfos.emplace_back(InvalidFlatIndex);
-            }
-            _children[modIndex]._downInfos.emplace_back(offset);
+            _parents[downModIndex]._upInfos.emplace_back(Instance(Node(_mods[modIndex], instIndex)), modIndex, offset);
+            setDownInfo(modIndex, instIndex, DownInfo(offset, downModIndex));
         }
     }
+    _numRenumbered = numMods;
+}
+
+void FlatView::buildEndIndexes() const {
+    Size numMods = _mods.size();
+    _wireEndIndexs.assign(numMods + 1, 0);
+    _portEndIndexs.assign(numMods + 1, 0);
+    // Counted from the modules, so that the tables are not needed
+    internal::parallelFor(0, numMods, [&](Size i) {
+        _wireEndIndexs[i] = _mods[i]->_wires.numUsed() * getNumFlatInstanciations(i);
+        _portEndIndexs[i] = _mods[i]->_numPorts * getNumFlatInstanciations(i);
+    });
+    internal::parallelExclusiveScan(_wireEndIndexs);
+    internal::parallelExclusiveScan(_portEndIndexs);
+
+    initLookups();
+}
+
+void internal::RangeLookup::init(const std::vector<FlatSize>& endIndexs) {
+    assert(endIndexs.size() >= 2);
+    Size numRanges = endIndexs.size() - 1;
+    FlatSize total = endIndexs.back();
+    // About two buckets per interval
+    _shift = 0;
+    while (total > 0 && ((total - 1) >> _shift) >= 2 * static_cast<FlatSize>(numRanges)) {
+        ++_shift;
+    }
+    FlatSize numBuckets = total > 0 ? ((total - 1) >> _shift) + 1 : 1;
+    _buckets.resize(numBuckets + 1);
+    Size cur = 0;
+    for (FlatSize b=0; b<numBuckets; ++b) {
+        FlatSize start = b << _shift;
+        while (cur + 1 < numRanges && endIndexs[cur+1] <= start) {
+            ++cur;
+        }
+        _buckets[b] = cur;
+    }
+    _buckets[numBuckets] = numRanges - 1;
+}
 
-    _wireEndIndexs.push_back(0);
-    _portEndIndexs.push_back(0);
+void FlatView::initLookups() const {
+    _modLookup.init(_modEndIndexs);
+    _wireLookup.init(_wireEndIndexs);
+    _portLookup.init(_portEndIndexs);
+    _numInstDividers.clear();
     for (Size i=0; i<_mods.size(); ++i) {
-        Module module(_mods[i]);
-        for (Wire wire : module.wires()) {
-            _wires[i].push_back(wire.ref()._ind);
-            while (_wireHierToInternal[i].size() < wire.ref()._ind) {
-                _wireHierToInternal[i].push_back(InvalidIndex);
-            }
-            _wireHierToInternal[i].push_back(_wires[i].size()-1);
-            assert(_wireHierToInternal[i].size() == wire.ref()._ind + 1);
-        }
-        _wireEndIndexs.push_back(_wireEndIndexs.back() + _wires[i].size() * getNumFlatInstanciations(i));
-        for (Port port : module.ports()) {
-            _ports[i].push_back(port.ref()._portInd);
-            while (_portHierToInternal[i].size() < port.ref()._portInd) {
-                _portHierToInternal[i].push_back(InvalidIndex);
-            }
-            _portHierToInternal[i].push_back(_ports[i].size()-1);
-            assert(_portHierToInternal[i].size() == port.ref()._portInd + 1);
+        _numInstDividers.emplace_back(getNumFlatInstanciations(i));
+    }
+}
+
+void FlatView::decodeIndexes(const std::vector<FlatSize>& endIndexs, const internal::RangeLookup& lookup, const std::vector<std::vector<Size> >& objects,
+                             const FlatSize* begin, const FlatSize* end, DecodedFlatIndex* out) const {
+    // Consecutive indexes often fall in the same module: only look it up when we leave the current range
+    Size modInd = 0;
+    FlatSize lo = 0, hi = 0;
+    for (const FlatSize* it = begin; it != end; ++it, ++out) {
+        FlatSize index = *it;
+        if (index < lo || index >= hi) {
+            modInd = lookup.find(endIndexs, index);
+            lo = endIndexs[modInd];
+            hi = endIndexs[modInd+1];
+            materialize(modInd);
         }
-        _portEndIndexs.push_back(_portEndIndexs.back() + _ports[i].size() * getNumFlatInstanciations(i));
+        const internal::Divider& div = _numInstDividers[modInd];
+        FlatSize localIndex = index - lo;
+        FlatSize internalIndex = div.divide(localIndex);
+        out->_ptr = _mods[modInd];
+        out->_ind = objects[modInd][internalIndex];
+        out->_occurrence = localIndex - internalIndex * div.divisor();
     }
+}
 
-    selfcheck();
+void FlatView::decodeWireIndexes(const FlatSize* begin, const FlatSize* end, DecodedFlatIndex* out) const {
+    sync();
+    decodeIndexes(_wireEndIndexs, _wireLookup, _wires, begin, end, out);
+}
+void FlatView::decodePortIndexes(const FlatSize* begin, const FlatSize* end, DecodedFlatIndex* out) const {
+    sync();
+    decodeIndexes(_portEndIndexs, _portLookup, _ports, begin, end, out);
+}
+void FlatView::decodeWireIndexes(const std::vector<FlatSize>& indexes, std::vector<DecodedFlatIndex>& out) const {
+    out.resize(indexes.size());
+    decodeWireIndexes(indexes.data(), indexes.data() + indexes.size(), out.data());
+}
+void FlatView::decodePortIndexes(const std::vector<FlatSize>& indexes, std::vector<DecodedFlatIndex>& out) const {
+    out.resize(indexes.size());
+    decodePortIndexes(indexes.data(), indexes.data() + indexes.size(), out.data());
 }
 
 void FlatView::selfcheck() const {
+    if (_cyclic) {
+        assert(_mods.empty() && _modEndIndexs.size() == 1);
+        return;
+    }
     assert(!_mods.empty() && _mods.front() == _topMod.ref()._ptr);
     assert(_modEndIndexs.size() == _mods.size() + 1);
     assert(_wires.size() == _mods.size());
@@ -121,8 +695,18 @@ void FlatView::selfcheck() const {
     assert(_wireEndIndexs.size() == _mods.size() + 1);
     assert(_portEndIndexs.size() == _mods.size() + 1);
 
+    // Per-module checks are independent
+    internal::parallelFor(0, _mods.size(), [this](Size i) {
+        selfcheck(i);
+    });
+}
+
+void FlatView::selfcheck(Size i) const {
+    assert(_wireEndIndexs[i+1] - _wireEndIndexs[i] == _mods[i]->_wires.numUsed() * getNumFlatInstanciations(i));
+    assert(_portEndIndexs[i+1] - _portEndIndexs[i] == _mods[i]->_numPorts * getNumFlatInstanciations(i));
+
     // Checks for all but the top Module
-    for (Size i=1; i<_mods.size(); ++i) {
+    if (i != 0) {
         assert(_parents[i]._instEndIndexs.front() == 0);
         assert(_parents[i]._instEndIndexs.back() == _modEndIndexs[i+1] - _modEndIndexs[i]);
         assert(_parents[i]._instEndIndexs.size() == _parents[i]._upInfos.size() + 1);
@@ -130,13 +714,34 @@ void FlatView::selfcheck() const {
         for (Size j=0; j<_parents[i]._upInfos.size(); ++j) {
             UpInfo upInfo = _parents[i]._upInfos[j];
             Instance inst = upInfo._parentInstance;
-            Size parentInd = getModIndex(inst.getParentModule());
+            Size parentInd = getModIndex(inst.ref()._ptr);
             assert(parentInd < i);
+            assert(parentInd == upInfo._parentModIndex);
         }
     }
 
+    // The child counts follow the instances, in order of first instanciation
+    Size numInstances = 0, numCounted = 0;
+    for (internal::ModuleImpl* downModule : _instances[i]) {
+        if (downModule != nullptr) {
+            ++numInstances;
+        }
+    }
+    for (Size j=0; j<_childCounts[i].size(); ++j) {
+        const ChildCount& child = _childCounts[i][j];
+        assert(child._count > 0 && _instances[i].at(child._first) == child._downModule);
+        assert(j == 0 || _childCounts[i][j-1]._first < child._first);
+        numCounted += child._count;
+    }
+    assert(numInstances == numCounted);
+    (void) numInstances;
+    (void) numCounted;
+
     // Children are enumerated in order of their index in the gbl module
-    for (Size i=0; i<_mods.size(); ++i) {
+    if (_materialized[i].load()) {
+        assert(_wires[i].size() == _mods[i]->_wires.numUsed());
+        assert(_ports[i].size() == _mods[i]->_numPorts);
+
         // Test strictly ordered collections
         assert( std::is_sorted(_wires[i].begin(), _wires[i].end()) );
         assert( std::is_sorted(_ports[i].begin(), _ports[i].end()) );
@@ -0,0 +1,130 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl_hierarchy.hh"
+
+#include <unordered_map>
+#include <mutex>
+
+namespace gbl {
+
+namespace { // Helpers
+// Orders shared by top module; all of them are dropped when the instanciation graph changes
+class HierarchyOrderCache {
+    public:
+    std::shared_ptr<const HierarchyOrder> get(Module top) {
+        std::lock_guard<std::mutex> guard(_lock);
+        std::uint64_t epoch = internal::hierarchyEpoch().load();
+        if (epoch != _epoch) {
+            _orders.clear();
+            _epoch = epoch;
+        }
+        std::shared_ptr<const HierarchyOrder>& order = _orders[top.ref()._ptr];
+        if (!order || !order->isUpToDate()) {
+            order = std::make_shared<HierarchyOrder>(top);
+        }
+        return order;
+    }
+
+    HierarchyOrderCache() : _epoch(0) {}
+
+    private:
+    std::mutex _lock;
+    std::unordered_map<internal::ModuleImpl*, std::shared_ptr<const HierarchyOrder> > _orders;
+    std::uint64_t _epoch;
+};
+} // End anonymous namespace
+
+std::shared_ptr<const HierarchyOrder> HierarchyOrder::get(Module top) {
+    static HierarchyOrderCache cache;
+    return cache.get(top);
+}
+
+HierarchyOrder::HierarchyOrder(Module top)
+: _top(top.ref()._ptr)
+, _epoch(0)
+{
+    compute();
+}
+
+void HierarchyOrder::compute() {
+    // Read first: edits during the traversal make the order stale
+    _epoch = internal::hierarchyEpoch().load();
+
+    // Traversal state, indexed by module identifier
+    enum State : char { Unvisited, InProgress, Done };
+    std::vector<char> states;
+    std::vector<std::vector<internal::ModuleImpl*> > childrenById;
+    std::vector<internal::ModuleImpl*> lastParent;
+    auto reserveId = [&](Size id) {
+        if (id >= states.size()) {
+            states.resize(id+1, Unvisited);
+            childrenById.resize(id+1);
+            lastParent.resize(id+1, nullptr);
+        }
+    };
+
+    // Iterative depth-first traversal, so that deep hierarchies don't overflow the stack
+    struct Frame {
+        internal::ModuleImpl* _module;
+        Size                  _nextChild;
+    };
+    std::vector<Frame> stack;
+    std::vector<internal::ModuleImpl*> postOrder;
+    auto enter = [&](internal::ModuleImpl* module) {
+        reserveId(module->_id);
+        states[module->_id] = InProgress;
+        for (Instance instance : Module(module).instances()) {
+            internal::ModuleImpl* downModule = instance.getDownModule().ref()._ptr;
+            reserveId(downModule->_id);
+            // Each child is listed once, in order of first instanciation
+            if (lastParent[downModule->_id] != module) {
+                lastParent[downModule->_id] = module;
+                childrenById[module->_id].push_back(downModule);
+            }
+        }
+        stack.push_back(Frame{module, 0});
+    };
+
+    enter(_top);
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        const std::vector<internal::ModuleImpl*>& children = childrenById[frame._module->_id];
+        if (frame._nextChild == children.size()) {
+            states[frame._module->_id] = Done;
+            postOrder.push_back(frame._module);
+            stack.pop_back();
+            continue;
+        }
+        internal::ModuleImpl* child = children[frame._nextChild++];
+        if (states[child->_id] == Unvisited) {
+            enter(child);
+        }
+        else if (states[child->_id] == InProgress) {
+            // The modules on the stack from the child onwards form a cycle
+            Size start = 0;
+            while (stack[start]._module != child) {
+                ++start;
+            }
+            for (Size i=start; i<stack.size(); ++i) {
+                _cycle.push_back(stack[i]._module);
+            }
+            return;
+        }
+    }
+
+    // Reverse postorder: parents before their children
+    _mods.assign(postOrder.rbegin(), postOrder.rend());
+    _id2Index.assign(states.size(), InvalidIndex);
+    for (Size i=0; i<_mods.size(); ++i) {
+        _id2Index[_mods[i]->_id] = i;
+    }
+    _children.resize(_mods.size());
+    for (Size i=0; i<_mods.size(); ++i) {
+        for (internal::ModuleImpl* child : childrenById[_mods[i]->_id]) {
+            _children[i].push_back(_id2Index[child->_id]);
+        }
+    }
+}
+
+} // End namespace gbl
+
@@ -0,0 +1,130 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl_hmetis.hh"
+#include "gbl_hierarchy.hh"
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+namespace gbl {
+
+namespace {
+// Dense numbering of the leaf occurrences, from the contiguous flat ranges of the leaf modules
+// The top module is never a vertex, even if it is a leaf: it is not an instance
+class LeafVertices {
+  public:
+  explicit LeafVertices(const FlatView& view) {
+      Module top = view.getTop().getObject();
+      std::shared_ptr<const HierarchyOrder> order = HierarchyOrder::get(top);
+      for (Size i=0; i<order->size(); ++i) {
+          Module module = order->getModule(i);
+          if (!module.isLeaf() || module == top) continue;
+          FlatRange range = view.getFlatRange(module);
+          if (range.second > range.first) {
+              _ranges.push_back(range);
+          }
+      }
+      std::sort(_ranges.begin(), _ranges.end());
+      _offsets.push_back(0);
+      for (FlatRange range : _ranges) {
+          _offsets.push_back(_offsets.back() + range.second - range.first);
+      }
+  }
+
+  FlatSize getNumVertices() const { return _offsets.back(); }
+
+  // Vertex of a flat node, or InvalidFlatIndex if it is not a leaf occurrence
+  FlatSize getVertex(FlatSize nodeIndex) const {
+      auto it = std::upper_bound(_ranges.begin(), _ranges.end(), FlatRange(nodeIndex, InvalidFlatIndex));
+      if (it == _ranges.begin()) return InvalidFlatIndex;
+      --it;
+      if (nodeIndex >= it->second) return InvalidFlatIndex;
+      return _offsets[it - _ranges.begin()] + nodeIndex - it->first;
+  }
+
+  // Flat node of a vertex
+  FlatSize getNode(FlatSize vertex) const {
+      Size i = std::upper_bound(_offsets.begin(), _offsets.end(), vertex) - _offsets.begin() - 1;
+      return _ranges[i].first + vertex - _offsets[i];
+  }
+
+  private:
+  std::vector<FlatRange> _ranges;
+  std::vector<FlatSize>  _offsets;
+};
+
+// Distinct vertices of a net, sorted
+void getNetVertices(const FlatView& view, const FlatNets& nets, const LeafVertices& vertices, FlatSize net, std::vector<FlatSize>& out) {
+    out.clear();
+    FlatRange range = nets.getPinRange(net);
+    for (FlatSize i=range.first; i<range.second; ++i) {
+        FlatModulePort pin = view.getFlatModulePortByIndex(nets.getNetPins()[i]);
+        if (pin.isTopPort()) continue;
+        out.push_back(vertices.getVertex(pin.getNode().getIndex()));
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void writeHMetis(std::ostream& out, const FlatView& view, const FlatNets& nets, bool weighted, ID weightAttribute) {
+    LeafVertices vertices(view);
+    std::vector<FlatSize> netVertices;
+    // The header needs the number of hyperedges: the nets are visited twice rather than stored
+    FlatSize numEdges = 0;
+    for (FlatSize net=0; net<nets.getNumNets(); ++net) {
+        getNetVertices(view, nets, vertices, net, netVertices);
+        if (netVertices.size() >= 2) {
+            ++numEdges;
+        }
+    }
+    out << numEdges << " " << vertices.getNumVertices();
+    if (weighted) {
+        out << " 10";
+    }
+    out << "\n";
+    for (FlatSize net=0; net<nets.getNumNets(); ++net) {
+        getNetVertices(view, nets, vertices, net, netVertices);
+        if (netVertices.size() < 2) continue;
+        for (Size i=0; i<netVertices.size(); ++i) {
+            // Vertices are numbered from 1
+            out << (i == 0 ? "" : " ") << netVertices[i] + 1;
+        }
+        out << "\n";
+    }
+    if (!weighted) return;
+    for (FlatSize vertex=0; vertex<vertices.getNumVertices(); ++vertex) {
+        FlatInstance inst = view.getFlatInstanceByIndex(vertices.getNode(vertex));
+        Module leaf = inst.getObject().getDownModule();
+        std::int64_t weight = inst.hasAttribute(weightAttribute) ? inst.getAttribute(weightAttribute)
+                            : leaf.hasAttribute(weightAttribute) ? leaf.getAttribute(weightAttribute) : 1;
+        // hMETIS only accepts positive weights
+        out << std::max<std::int64_t>(weight, 1) << "\n";
+    }
+}
+} // End anonymous namespace
+
+void writeHMetis(std::ostream& out, const FlatView& view, const FlatNets& nets) {
+    writeHMetis(out, view, nets, false, 0);
+}
+
+void writeHMetis(std::ostream& out, const FlatView& view, const FlatNets& nets, ID weightAttribute) {
+    writeHMetis(out, view, nets, true, weightAttribute);
+}
+
+bool readHMetisPartition(std::istream& in, const FlatView& view, std::vector<Size>& parts) {
+    LeafVertices vertices(view);
+    parts.assign(view.getNumFlatModules(), InvalidIndex);
+    for (FlatSize vertex=0; vertex<vertices.getNumVertices(); ++vertex) {
+        Size part;
+        if (!(in >> part)) {
+            return false;
+        }
+        parts[vertices.getNode(vertex)] = part;
+    }
+    in >> std::ws;
+    return in.eof();
+}
+
+} // End namespace gbl
+
@@ -0,0 +1,187 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl_journal.hh"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace gbl {
+
+JournalWire::JournalWire(Wire wire) : _ind(wire.ref()._ind), _isNew(false) {}
+JournalWire::JournalWire(Size ind, bool isNew) : _ind(ind), _isNew(isNew) {}
+bool JournalWire::isNew() const { return _isNew; }
+
+JournalNode::JournalNode(Node node) : _ind(node.ref()._ind), _isNew(false) {}
+JournalNode::JournalNode(Size ind, bool isNew) : _ind(ind), _isNew(isNew) {}
+bool JournalNode::isNew() const { return _isNew; }
+
+EditJournal::EditJournal(Module module)
+: _module(module)
+, _numNewWires(0)
+, _numNewNodes(0)
+, _status(Pending)
+{
+}
+
+Size EditJournal::size() const {
+    return _ops.size();
+}
+
+bool EditJournal::isMerged() const {
+    return _status == Merged;
+}
+
+bool EditJournal::isRejected() const {
+    return _status == Rejected;
+}
+
+void EditJournal::touch(Wire wire) {
+    assert(wire.ref()._ptr == _module.ref()._ptr);
+    _touchedWires.push_back(wire.ref()._ind);
+}
+
+void EditJournal::touch(Node node) {
+    assert(node.ref()._ptr == _module.ref()._ptr);
+    _touchedNodes.push_back(node.ref()._ind);
+}
+
+JournalWire EditJournal::createWire() {
+    assert(_status == Pending);
+    JournalWire wire(_numNewWires++, true);
+    _ops.emplace_back(CreateWire, JournalNode(0, false), wire);
+    return wire;
+}
+
+JournalNode EditJournal::createInstance(Module downModule) {
+    assert(_status == Pending);
+    JournalNode node(_numNewNodes++, true);
+    _ops.emplace_back(CreateInstance, node, JournalWire(0, false), 0, downModule);
+    return node;
+}
+
+void EditJournal::connect(JournalNode node, Size portInd, JournalWire wire) {
+    assert(_status == Pending);
+    if (!node.isNew()) {
+        touch(Node(_module.ref()._ptr, node._ind));
+    }
+    if (!wire.isNew()) {
+        touch(Wire(_module.ref()._ptr, wire._ind));
+    }
+    _ops.emplace_back(Connect, node, wire, portInd);
+}
+
+void EditJournal::connect(Port port, JournalWire wire) {
+    connect(port.getNode(), port.ref()._portInd, wire);
+}
+
+void EditJournal::disconnect(Port port) {
+    assert(_status == Pending);
+    assert(port.isConnected());
+    touch(port.getNode());
+    touch(port.getWire());
+    _ops.emplace_back(Disconnect, JournalNode(port.getNode()), JournalWire(port.getWire()), port.ref()._portInd);
+}
+
+void EditJournal::destroy(JournalNode instance) {
+    assert(_status == Pending);
+    if (!instance.isNew()) {
+        Instance inst(Node(_module.ref()._ptr, instance._ind));
+        assert(inst.isValid() && inst.isInstance());
+        touch(inst);
+        for (Port port : inst.ports()) {
+            if (port.isConnected()) {
+                touch(port.getWire());
+            }
+        }
+    }
+    _ops.emplace_back(DestroyInstance, instance, JournalWire(0, false));
+}
+
+void EditJournal::destroy(JournalWire wire) {
+    assert(_status == Pending);
+    if (!wire.isNew()) {
+        Wire w(_module.ref()._ptr, wire._ind);
+        assert(w.isValid());
+        touch(w);
+        for (Port port : w.ports()) {
+            touch(port.getNode());
+        }
+    }
+    _ops.emplace_back(DestroyWire, JournalNode(0, false), wire);
+}
+
+Size EditJournal::getWireIndex(JournalWire wire) const {
+    return wire.isNew() ? _newWires[wire._ind] : wire._ind;
+}
+
+Size EditJournal::getNodeIndex(JournalNode node) const {
+    return node.isNew() ? _newNodes[node._ind] : node._ind;
+}
+
+Wire EditJournal::getWire(JournalWire wire) const {
+    assert(_status == Merged);
+    return Wire(_module.ref()._ptr, getWireIndex(wire));
+}
+
+Instance EditJournal::getInstance(JournalNode instance) const {
+    assert(_status == Merged);
+    return Instance(Node(_module.ref()._ptr, getNodeIndex(instance)));
+}
+
+void EditJournal::apply() {
+    internal::ModuleImpl* ptr = _module.ref()._ptr;
+    for (const Op& op : _ops) {
+        switch (op._type) {
+          case CreateWire:
+            _newWires.push_back(_module.createWire().ref()._ind);
+            break;
+          case CreateInstance:
+            _newNodes.push_back(_module.createInstance(op._downModule).ref()._ind);
+            break;
+          case Connect:
+            Port(ptr, getNodeIndex(op._node), op._portInd).connect(Wire(ptr, getWireIndex(op._wire)));
+            break;
+          case Disconnect:
+            Port(ptr, getNodeIndex(op._node), op._portInd).disconnect();
+            break;
+          case DestroyInstance:
+            Instance(Node(ptr, getNodeIndex(op._node))).destroy();
+            break;
+          case DestroyWire:
+            Wire(ptr, getWireIndex(op._wire)).destroy();
+            break;
+        }
+    }
+    _status = Merged;
+}
+
+void EditJournal::merge(std::vector<EditJournal>& journals) {
+    // Objects touched by the journals accepted so far, for each module
+    struct Touched {
+        std::unordered_set<Size> _wires;
+        std::unordered_set<Size> _nodes;
+    };
+    std::unordered_map<internal::ModuleImpl*, Touched> touched;
+
+    for (EditJournal& journal : journals) {
+        assert(journal._status == Pending);
+        Touched& cur = touched[journal._module.ref()._ptr];
+        bool conflict = false;
+        for (Size wire : journal._touchedWires) {
+            conflict = conflict || cur._wires.count(wire) != 0;
+        }
+        for (Size node : journal._touchedNodes) {
+            conflict = conflict || cur._nodes.count(node) != 0;
+        }
+        if (conflict) {
+            journal._status = Rejected;
+            continue;
+        }
+        cur._wires.insert(journal._touchedWires.begin(), journal._touchedWires.end());
+        cur._nodes.insert(journal._touchedNodes.begin(), journal._touchedNodes.end());
+        journal.apply();
+    }
+}
+
+} // End namespace gbl
+
@@ -0,0 +1,243 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "gbl.hh"
+#include "gbl_symbols.hh"
+
+#include <unordered_map>
+
+namespace gbl {
+
+std::vector<Size> Module::getPortMappingByName(Module other) {
+    assert(isValid());
+    assert(other.isValid());
+    std::unordered_map<ID, Size> otherPorts;
+    for (ModulePort port : other.ports()) {
+        for (ID name : port.names()) {
+            otherPorts.emplace(name, port.ref()._portInd);
+        }
+    }
+    std::vector<Size> mapping(_ref._ptr->_nodes[0]._refs.size(), InvalidIndex);
+    for (ModulePort port : ports()) {
+        for (ID name : port.names()) {
+            auto it = otherPorts.find(name);
+            if (it != otherPorts.end()) {
+                mapping[port.ref()._portInd] = it->second;
+                break;
+            }
+        }
+    }
+    return mapping;
+}
+
+namespace internal {
+void remapPorts(ModuleImpl* module, Size nodeInd, const std::vector<Size>& portMap) {
+    NodeImpl& node = module->_nodes[nodeInd];
+
+    // Move the connections, and update the slot recorded on the wire side
+    std::vector<Xref> refs;
+    for (Size i=0; i<node._refs.size(); ++i) {
+        const Xref& ref = node._refs[i];
+        if (!ref.isValid() || !ref.isConnected()) continue;
+        module->_wires[ref._obj_id]._driver.invalidate();
+        Size j = i < portMap.size() ? portMap[i] : InvalidIndex;
+        if (j == InvalidIndex) {
+            module->_wires[ref._obj_id]._refs.erase(ref._ind);
+            continue;
+        }
+        if (refs.size() <= j) {
+            refs.resize(j+1, Xref(EmptyInd, EmptyInd));
+        }
+        assert(!refs[j].isConnected());
+        refs[j] = ref;
+        module->_wires[ref._obj_id]._refs[ref._ind]._ind = j;
+    }
+    std::vector<DataImpl> data;
+    for (Size i=0; i<node._refData.size(); ++i) {
+        Size j = i < portMap.size() ? portMap[i] : InvalidIndex;
+        if (j == InvalidIndex) continue;
+        if (data.size() <= j) {
+            data.resize(j+1);
+        }
+        data[j] = std::move(node._refData[i]);
+    }
+    if (nodeInd == 0) {
+        std::vector<std::uint8_t> dirs;
+        for (Size i=0; i<module->_portDirs.size(); ++i) {
+            Size j = i < portMap.size() ? portMap[i] : InvalidIndex;
+            if (j == InvalidIndex) continue;
+            if (dirs.size() <= j) {
+                dirs.resize(j+1, 0);
+            }
+            dirs[j] = module->_portDirs[i];
+        }
+        module->_portDirs.swap(dirs);
+        ++directionEpoch();
+    }
+    node._refs.swap(refs);
+    node._refData.swap(data);
+}
+} // End namespace gbl::internal
+
+namespace internal {
+Size updateDriver(ModuleImpl* module, Size wireInd) {
+    // Read before the scan: a direction change during the scan leaves the cache invalid
+    std::uint64_t epoch = directionEpoch().load(std::memory_order_acquire);
+    const XrefList& refs = module->_wires[wireInd]._refs;
+    Size driver = EmptyInd;
+    for (Size i=0; i<refs.size() && driver == EmptyInd; ++i) {
+        const Xref& ref = refs[i];
+        if (!ref.isValid() || !ref.isConnected()) continue;
+        const std::vector<std::uint8_t>& dirs = module->_nodes[ref._obj_id]._instanciation->_portDirs;
+        ID dir = ref._ind < dirs.size() ? dirs[ref._ind] : 0;
+        // A module port drives the wire from the outside
+        if (dir == (ref._obj_id == 0 ? Symbol::DIR_IN : Symbol::DIR_OUT)) {
+            driver = i;
+        }
+    }
+    // Concurrent readers compute the same value
+    DriverCache& cache = module->_wires[wireInd]._driver;
+    cache._slot.store(driver, std::memory_order_relaxed);
+    cache._epoch.store(epoch, std::memory_order_release);
+    return driver;
+}
+
+bool isDirection(ID id) {
+    return id == Symbol::DIR_IN || id == Symbol::DIR_INOUT || id == Symbol::DIR_OUT;
+}
+
+void setPortDirection(ModuleImpl* module, Size portInd, ID dir) {
+    std::vector<DataImpl>& data = module->_nodes[0]._refData;
+    if (data.size() <= portInd) {
+        data.resize(portInd+1);
+    }
+    for (ID other : {Symbol::DIR_IN, Symbol::DIR_INOUT, Symbol::DIR_OUT}) {
+        if (other != dir) {
+            data[portInd].eraseProp(other);
+        }
+    }
+    if (dir != 0) {
+        data[portInd].addProp(dir);
+    }
+    syncPortDirection(module, portInd, dir);
+}
+
+void syncPortDirection(ModuleImpl* module, Size portInd, ID added) {
+    ID dir = added;
+    if (dir == 0 && portInd < module->_nodes[0]._refData.size()) {
+        // Fall back to another DIR_* property of the port
+        for (ID prop : module->_nodes[0]._refData[portInd]._props) {
+            if (isDirection(prop)) {
+                dir = prop;
+            }
+        }
+    }
+    if (module->_portDirs[portInd] != dir) {
+        module->_portDirs[portInd] = dir;
+        ++directionEpoch();
+    }
+}
+} // End namespace gbl::internal
+
+void Module::destroyInstances(const std::vector<Instance>& instances) {
+    assert(isValid());
+    internal::ModuleImpl* ptr = _ref._ptr;
+    for (Instance instance : instances) {
+        assert(instance.ref()._ptr == ptr);
+        assert(instance.isValid() && instance.isInstance());
+        // The node-side references go away with the node: only the wires are updated
+        for (const internal::Xref& ref : ptr->_nodes[instance.ref()._ind]._refs) {
+            if (ref.isValid() && ref.isConnected()) {
+                ptr->_wires[ref._obj_id]._refs.erase(ref._ind);
+                ptr->_wires[ref._obj_id]._driver.invalidate();
+            }
+        }
+        ptr->_nodes.deallocate(instance.ref()._ind);
+    }
+    if (!instances.empty()) {
+        ++internal::hierarchyEpoch();
+        // One notification per node, so that the views don't visit the remaining instances
+        for (Instance instance : instances) {
+            ptr->notify(internal::ModuleObserver::InstanceEdit, instance.ref()._ind);
+        }
+    }
+}
+
+void Module::destroyWires(const std::vector<Wire>& wires) {
+    assert(isValid());
+    internal::ModuleImpl* ptr = _ref._ptr;
+    for (Wire wire : wires) {
+        assert(wire.ref()._ptr == ptr);
+        assert(wire.isValid());
+        // The wire-side references go away with the wire: only the nodes are updated
+        internal::XrefList& refs = ptr->_wires[wire.ref()._ind]._refs;
+        for (Size i=0; i<refs.size(); ++i) {
+            if (refs[i].isValid() && refs[i].isConnected()) {
+                ptr->_nodes[refs[i]._obj_id]._refs[refs[i]._ind] = internal::Xref::Disconnected();
+            }
+        }
+        ptr->_wires.deallocate(wire.ref()._ind);
+    }
+    if (!wires.empty()) {
+        ptr->notify(internal::ModuleObserver::WireEdit);
+    }
+}
+
+void Wire::mergeInto(Wire target) {
+    assert(isValid());
+    assert(target.isValid());
+    assert(target._ref._ptr == _ref._ptr && target != *this);
+    internal::ModuleImpl* ptr = _ref._ptr;
+    internal::XrefList& from = ptr->_wires[_ref._ind]._refs;
+    internal::XrefList& to = ptr->_wires[target._ref._ind]._refs;
+    // The source list is dropped as a whole rather than freed entry by entry
+    for (Size i=0; i<from.size(); ++i) {
+        const internal::Xref ref = from[i];
+        if (!ref.isValid() || !ref.isConnected()) continue;
+        Size slot = to.push();
+        to[slot] = ref;
+        ptr->_nodes[ref._obj_id]._refs[ref._ind] = internal::Xref(target._ref._ind, slot);
+    }
+    from.clear();
+    ptr->_wires[target._ref._ind]._driver.invalidate();
+    destroy();
+}
+
+Wire Wire::split(const std::vector<Port>& ports) {
+    assert(isValid());
+    internal::ModuleImpl* ptr = _ref._ptr;
+    Wire wire = getParentModule().createWire();
+    internal::XrefList& from = ptr->_wires[_ref._ind]._refs;
+    internal::XrefList& to = ptr->_wires[wire._ref._ind]._refs;
+    for (Port port : ports) {
+        assert(port.ref()._ptr == ptr);
+        internal::Xref& nodeRef = ptr->_nodes[port.ref()._instInd]._refs[port.ref()._portInd];
+        assert(nodeRef.isValid() && nodeRef.isConnected() && nodeRef._obj_id == _ref._ind);
+        Size slot = to.push();
+        to[slot] = from[nodeRef._ind];
+        from.erase(nodeRef._ind);
+        nodeRef = internal::Xref(wire._ref._ind, slot);
+    }
+    ptr->_wires[_ref._ind]._driver.invalidate();
+    ptr->_wires[wire._ref._ind]._driver.invalidate();
+    ptr->touch();
+    return wire;
+}
+
+void Instance::replaceModule(Module mod, const std::vector<Size>& portMap) {
+    assert(isValid());
+    assert(mod.isValid());
+    internal::ModuleImpl* ptr = _ref._ptr;
+#ifndef NDEBUG
+    const std::vector<internal::Xref>& newPorts = mod.ref()._ptr->_nodes[0]._refs;
+    for (Size j : portMap) {
+        assert(j == InvalidIndex || (j < newPorts.size() && newPorts[j].isValid()));
+    }
+#endif
+    internal::remapPorts(ptr, _ref._ind, portMap);
+    ptr->_nodes[_ref._ind]._instanciation = mod.ref()._ptr;
+    ++internal::hierarchyEpoch();
+    ptr->notify(internal::ModuleObserver::InstanceEdit, _ref._ind);
+}
+
+} // End namespace gbl
+
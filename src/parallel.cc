@@ -0,0 +1,165 @@
+// Copyright (C) 2016 Gabriel Gouvine - All Rights Reserved
+
+#include "private/gbl_parallel.hh"
+
+#include <cstdlib>
+#include <random>
+
+namespace gbl {
+namespace internal {
+
+namespace {
+// Queue of the current thread; 0 for the threads outside the pool
+thread_local unsigned currentThreadIndex = 0;
+
+unsigned getDefaultNumThreads() {
+    const char* env = std::getenv("GBL_NUM_THREADS");
+    if (env != nullptr && std::atoi(env) > 0) {
+        return std::atoi(env);
+    }
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? hw : 1;
+}
+
+bool getDefaultRandomScheduling() {
+    const char* env = std::getenv("GBL_RANDOM_SCHEDULING");
+    return env != nullptr && std::atoi(env) > 0;
+}
+
+unsigned getRandom(unsigned bound) {
+    thread_local std::minstd_rand rengine(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return std::uniform_int_distribution<unsigned>(0, bound - 1)(rengine);
+}
+} // End anonymous namespace
+
+ThreadPool& ThreadPool::get() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool()
+: _numQueued(0)
+, _numSleeping(0)
+, _stop(false)
+, _random(getDefaultRandomScheduling())
+{
+    startThreads(getDefaultNumThreads());
+}
+
+ThreadPool::~ThreadPool() {
+    stopThreads();
+}
+
+void ThreadPool::setNumThreads(unsigned numThreads) {
+    stopThreads();
+    startThreads(numThreads > 0 ? numThreads : 1);
+}
+
+void ThreadPool::startThreads(unsigned numThreads) {
+    assert(_numQueued == 0);
+    _stop = false;
+    _queues.clear();
+    for (unsigned t=0; t<numThreads; ++t) {
+        _queues.emplace_back(new WorkQueue());
+    }
+    for (unsigned t=1; t<numThreads; ++t) {
+        _threads.emplace_back(&ThreadPool::workerLoop, this, t);
+    }
+}
+
+void ThreadPool::stopThreads() {
+    {
+        std::lock_guard<std::mutex> guard(_sleepLock);
+        _stop = true;
+    }
+    _wakeCond.notify_all();
+    for (std::thread& thread : _threads) {
+        thread.join();
+    }
+    _threads.clear();
+}
+
+void ThreadPool::push(Task&& task) {
+    WorkQueue& queue = *_queues[currentThreadIndex];
+    {
+        std::lock_guard<std::mutex> guard(queue._lock);
+        queue._tasks.push_back(std::move(task));
+    }
+    // Both counters are sequentially consistent: either the sleeper sees the task, or we see the sleeper
+    ++_numQueued;
+    if (_numSleeping > 0) {
+        std::lock_guard<std::mutex> guard(_sleepLock);
+        _wakeCond.notify_one();
+    }
+}
+
+bool ThreadPool::pop(Task& task, const TaskGroup* group) {
+    if (_numQueued == 0) {
+        return false;
+    }
+    unsigned numQueues = _queues.size();
+    bool random = _random;
+    // Newest task of our own queue first, then the oldest task of the others
+    for (unsigned k=0; k<numQueues; ++k) {
+        unsigned victim = random ? getRandom(numQueues) : (currentThreadIndex + k) % numQueues;
+        WorkQueue& queue = *_queues[victim];
+        std::lock_guard<std::mutex> guard(queue._lock);
+        Size numTasks = queue._tasks.size();
+        if (numTasks == 0) {
+            continue;
+        }
+        Size start = random ? getRandom(numTasks) : 0;
+        bool fromBack = !random && victim == currentThreadIndex;
+        for (Size j=0; j<numTasks; ++j) {
+            Size pos = (start + j) % numTasks;
+            std::deque<Task>::iterator it = fromBack ? queue._tasks.end() - 1 - pos : queue._tasks.begin() + pos;
+            if (group != nullptr && it->_group != group) {
+                continue;
+            }
+            task = std::move(*it);
+            queue._tasks.erase(it);
+            --_numQueued;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runOneTask(const TaskGroup* group) {
+    Task task;
+    if (!pop(task, group)) {
+        return false;
+    }
+    task._func();
+    task._group->_pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned threadIndex) {
+    currentThreadIndex = threadIndex;
+    while (true) {
+        if (runOneTask()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(_sleepLock);
+        ++_numSleeping;
+        _wakeCond.wait(guard, [this]() { return _stop || _numQueued > 0; });
+        --_numSleeping;
+        if (_stop) {
+            return;
+        }
+    }
+}
+
+void TaskGroup::wait() {
+    ThreadPool& pool = ThreadPool::get();
+    while (_pending.load(std::memory_order_acquire) != 0) {
+        if (!pool.runOneTask(this)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // End namespace gbl::internal
+} // End namespace gbl
+
@@ -3,9 +3,16 @@
 #include "gbl.hh"
 #include "gbl_symbols.hh"
 #include "gbl_flatview.hh"
+#include "gbl_flatoverrides.hh"
+#include "gbl_flatnets.hh"
+#include "gbl_hmetis.hh"
+#include "gbl_census.hh"
+#include "gbl_flatsearch.hh"
+#include "gbl_flatcones.hh"
 
 #include <algorithm>
 #include <random>
+#include <sstream>
 
 using namespace gbl;
 using namespace gbl::internal;
@@ -65,5 +72,519 @@ BOOST_AUTO_TEST_CASE(testFlatView) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(testFlatOverrides) {
+    const ID sizeAttr = Symbol::ENUM_MAX_SYMBOL;
+    const ID dontTouch = Symbol::ENUM_MAX_SYMBOL + 1;
+    Module top = Module::createHier();
+    Module mid = Module::createHier();
+    Module leaf = Module::createLeaf();
+    ModulePort leafPort = leaf.createPort();
+    for (int i=0; i<3; ++i) {
+        top.createInstance(mid);
+    }
+    Instance leafInst = mid.createInstance(leaf);
+    leafInst.setAttribute(sizeAttr, 1);
+    InstancePort leafPin = leafPort.getUpPort(leafInst);
+    Wire midWire = mid.createWire();
+    leafPin.connect(midWire);
+
+    FlatView flatview(top);
+    BOOST_CHECK (flatview.contains(leaf));
+    BOOST_CHECK (!flatview.contains(Module::createLeaf()));
+    FlatNodeOverrides nodeOverrides(flatview);
+    FlatPortOverrides portOverrides(flatview);
+    FlatWireOverrides wireOverrides(flatview);
+
+    std::vector<FlatInstance> leafInsts;
+    for (FlatInstance midInst : flatview.getTop().instances()) {
+        for (FlatInstance inst : midInst.getDownModule().instances()) {
+            leafInsts.push_back(inst);
+        }
+    }
+    BOOST_CHECK_EQUAL (leafInsts.size(), 3u);
+    FlatRange range = flatview.getFlatRange(leafInst);
+    BOOST_CHECK_EQUAL (range.second - range.first, 3u);
+    for (FlatInstance inst : leafInsts) {
+        BOOST_CHECK (inst.getIndex() >= range.first && inst.getIndex() < range.second);
+        BOOST_CHECK_EQUAL (nodeOverrides.getAttribute(inst, sizeAttr), 1);
+        BOOST_CHECK (!nodeOverrides.hasProperty(inst, dontTouch));
+    }
+
+    nodeOverrides.setAttribute(leafInsts[1], sizeAttr, 4);
+    nodeOverrides.setProperty(leafInsts[2], dontTouch, true);
+    BOOST_CHECK_EQUAL (nodeOverrides.size(), 2u);
+    BOOST_CHECK_EQUAL (nodeOverrides.getAttribute(leafInsts[0], sizeAttr), 1);
+    BOOST_CHECK_EQUAL (nodeOverrides.getAttribute(leafInsts[1], sizeAttr), 4);
+    BOOST_CHECK_EQUAL (nodeOverrides.getAttribute(leafInsts[2], sizeAttr), 1);
+    BOOST_CHECK (!nodeOverrides.hasProperty(leafInsts[1], dontTouch));
+    BOOST_CHECK ( nodeOverrides.hasProperty(leafInsts[2], dontTouch));
+
+    std::vector<std::int64_t> sizes;
+    nodeOverrides.getAttributes(leafInst, sizeAttr, 0, sizes);
+    BOOST_CHECK_EQUAL (sizes.size(), 3u);
+    for (FlatInstance inst : leafInsts) {
+        BOOST_CHECK_EQUAL (sizes[inst.getIndex() - range.first], nodeOverrides.getAttribute(inst, sizeAttr));
+    }
+    std::vector<bool> flags;
+    nodeOverrides.getProperties(leafInst, dontTouch, flags);
+    for (FlatInstance inst : leafInsts) {
+        BOOST_CHECK_EQUAL (flags[inst.getIndex() - range.first], nodeOverrides.hasProperty(inst, dontTouch));
+    }
+
+    // Overrides on the first occurrence of the range are seen by the batched lookups
+    FlatInstance firstInst = flatview.getFlatInstanceByIndex(range.first);
+    nodeOverrides.setProperty(firstInst, dontTouch, true);
+    nodeOverrides.setAttribute(firstInst, sizeAttr, 5);
+    nodeOverrides.getProperties(leafInst, dontTouch, flags);
+    BOOST_CHECK (flags[0]);
+    nodeOverrides.getAttributes(leafInst, sizeAttr, 0, sizes);
+    BOOST_CHECK_EQUAL (sizes[0], 5);
+    BOOST_CHECK (nodeOverrides.eraseProperty(firstInst, dontTouch));
+    BOOST_CHECK (nodeOverrides.eraseAttribute(firstInst, sizeAttr));
+
+    // Overrides may also hide a hierarchical property
+    leafInst.addProperty(dontTouch);
+    nodeOverrides.setProperty(leafInsts[0], dontTouch, false);
+    BOOST_CHECK (!nodeOverrides.hasProperty(leafInsts[0], dontTouch));
+    BOOST_CHECK ( nodeOverrides.hasProperty(leafInsts[1], dontTouch));
+    BOOST_CHECK ( nodeOverrides.eraseProperty(leafInsts[0], dontTouch));
+    BOOST_CHECK (!nodeOverrides.eraseProperty(leafInsts[0], dontTouch));
+    BOOST_CHECK ( nodeOverrides.hasProperty(leafInsts[0], dontTouch));
+
+    // Ports and wires use their own flat index spaces
+    FlatInstance::PortIterator pinIt = leafInsts[1].ports().begin();
+    FlatInstancePort pin = *pinIt;
+    FlatInstance::PortIterator otherPinIt = leafInsts[0].ports().begin();
+    FlatRange pinRange = flatview.getFlatRange(leafPin);
+    BOOST_CHECK (pin.getIndex() >= pinRange.first && pin.getIndex() < pinRange.second);
+    portOverrides.setAttribute(pin, sizeAttr, 7);
+    BOOST_CHECK (!portOverrides.hasAttribute(*otherPinIt, sizeAttr));
+    BOOST_CHECK_EQUAL (portOverrides.getAttribute(pin.getDownPort(), sizeAttr), 7);
+    FlatWire wire = pin.getWire();
+    FlatRange wireRange = flatview.getFlatRange(midWire);
+    BOOST_CHECK (wire.getIndex() >= wireRange.first && wire.getIndex() < wireRange.second);
+    wireOverrides.setProperty(wire, dontTouch, true);
+    BOOST_CHECK (wireOverrides.hasProperty(wire, dontTouch));
+    wireOverrides.clear();
+    BOOST_CHECK (!wireOverrides.hasProperty(wire, dontTouch));
+}
+
+BOOST_AUTO_TEST_CASE(testOverlappingFlatViews) {
+    Module top1 = Module::createHier();
+    Module top2 = Module::createHier();
+    Module mid = Module::createHier();
+    Module leaf = Module::createLeaf();
+    for (int i=0; i<2; ++i) {
+        top1.createInstance(mid);
+    }
+    for (int i=0; i<3; ++i) {
+        mid.createInstance(leaf);
+        top2.createInstance(leaf);
+    }
+    top2.createInstance(mid);
+    FlatView view1(top1);
+    FlatView view2(top2);
+    FlatView view3(mid);
+    BOOST_CHECK_EQUAL (view1.getNumFlatInstanciations(leaf), 6u);
+    BOOST_CHECK_EQUAL (view2.getNumFlatInstanciations(leaf), 6u);
+    BOOST_CHECK_EQUAL (view3.getNumFlatInstanciations(leaf), 3u);
+    BOOST_CHECK_EQUAL (view1.getNumFlatInstanciations(mid), 2u);
+    BOOST_CHECK_EQUAL (view2.getNumFlatInstanciations(mid), 1u);
+    for (const FlatView* view : {&view1, &view2, &view3}) {
+        for (FlatSize i=1; i<view->getNumFlatModules(); ++i) {
+            BOOST_CHECK_EQUAL (view->getFlatInstanceByIndex(i).getIndex(), i);
+        }
+    }
+
+    // Identifiers of destroyed modules are reused
+    Size id;
+    {
+        Module tmp = Module::createLeaf();
+        id = tmp.ref()._ptr->_id;
+    }
+    Module reused = Module::createLeaf();
+    BOOST_CHECK_EQUAL (reused.ref()._ptr->_id, id);
+}
+
+BOOST_AUTO_TEST_CASE(testDivider) {
+    std::mt19937_64 rengine(0);
+    std::vector<std::uint64_t> divisors = {1, 2, 3, 5, 6, 7, 641, 1ull << 32, (1ull << 32) + 1, (1ull << 63) - 1, 1ull << 63, ~0ull};
+    for (int i=0; i<200; ++i) {
+        divisors.push_back(rengine() >> (rengine() % 64));
+    }
+    for (std::uint64_t d : divisors) {
+        if (d == 0) continue;
+        Divider div(d);
+        std::vector<std::uint64_t> numerators = {0, 1, d-1, d, d+1, 2*d, ~0ull, ~0ull - 1};
+        for (int i=0; i<200; ++i) {
+            numerators.push_back(rengine() >> (rengine() % 64));
+        }
+        for (std::uint64_t n : numerators) {
+            BOOST_CHECK_EQUAL (div.divide(n), n / d);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testBatchedDecoding) {
+    // Modules with different instanciation counts, including some with no wire or port
+    std::vector<Module> mods;
+    for (int i=0; i<6; ++i) {
+        mods.push_back(Module::createHier());
+    }
+    for (int i=1; i<6; ++i) {
+        for (int j=0; j<i+1; ++j) {
+            mods[i-1].createInstance(mods[i]);
+        }
+        if (i % 2 == 0) continue;
+        for (int j=0; j<3*i; ++j) {
+            mods[i].createWire();
+            mods[i].createPort();
+        }
+    }
+    mods[0].createWire();
+    FlatView view(mods[0]);
+
+    std::vector<FlatSize> indexes;
+    for (FlatSize i=0; i<view.getNumFlatWires(); ++i) {
+        indexes.push_back(i);
+    }
+    std::vector<DecodedFlatIndex> decoded;
+    for (int pass=0; pass<2; ++pass) {
+        view.decodeWireIndexes(indexes, decoded);
+        BOOST_CHECK_EQUAL (decoded.size(), indexes.size());
+        for (Size i=0; i<indexes.size(); ++i) {
+            FlatWire wire = view.getFlatWireByIndex(indexes[i]);
+            BOOST_CHECK (wire == FlatWire(Wire(decoded[i]._ptr, decoded[i]._ind), FlatRef(decoded[i]._occurrence, view)));
+        }
+        std::shuffle(indexes.begin(), indexes.end(), std::mt19937(pass));
+    }
+
+    indexes.clear();
+    for (FlatSize i=0; i<view.getNumFlatPorts(); ++i) {
+        indexes.push_back(i);
+    }
+    std::shuffle(indexes.begin(), indexes.end(), std::mt19937(0));
+    view.decodePortIndexes(indexes, decoded);
+    for (Size i=0; i<indexes.size(); ++i) {
+        FlatModulePort port = view.getFlatModulePortByIndex(indexes[i]);
+        BOOST_CHECK (port == FlatPort(Port(decoded[i]._ptr, 0, decoded[i]._ind), FlatRef(decoded[i]._occurrence, view)));
+        BOOST_CHECK_EQUAL (port.getIndex(), indexes[i]);
+    }
+}
+
+namespace {
+// Two buffers in a module, instanciated twice in a chain
+void createBufferChain(Module gate, Module mid, Module top) {
+    gate.createPort();
+    gate.createPort();
+    for (Module mod : {mid, top}) {
+        std::vector<Wire> wires;
+        for (int i=0; i<3; ++i) {
+            wires.push_back(mod.createWire());
+        }
+        // An unconnected wire
+        mod.createWire();
+        mod.createPort().connect(wires[0]);
+        mod.createPort().connect(wires[2]);
+        for (int i=0; i<2; ++i) {
+            Instance inst = mod.createInstance(mod == top ? mid : gate);
+            Instance::PortIterator it = inst.ports().begin();
+            (*it).connect(wires[i]);
+            ++it;
+            (*it).connect(wires[i+1]);
+        }
+    }
+}
+} // End anonymous namespace
+
+BOOST_AUTO_TEST_CASE(testFlatNets) {
+    Module gate = Module::createLeaf();
+    Module mid = Module::createHier();
+    Module top = Module::createHier();
+    createBufferChain(gate, mid, top);
+    FlatView view(top);
+    FlatNets nets(view);
+    // Two nets inside each mid, three through the ports, and the three unconnected wires
+    BOOST_CHECK_EQUAL (nets.getNumNets(), 2u + 3u + 3u);
+    BOOST_CHECK_EQUAL (nets.getNetPins().size(), 10u);
+
+    // Wires on both sides of a port are in the same net
+    for (FlatSize i=0; i<view.getNumFlatPorts(); ++i) {
+        FlatModulePort port = view.getFlatModulePortByIndex(i);
+        if (port.isTopPort() || !port.getObject().isConnected()) continue;
+        FlatInstancePort upPort = port.getUpPort();
+        BOOST_CHECK_EQUAL (nets.getWireNet(port.getWire().getIndex()), nets.getWireNet(upPort.getWire().getIndex()));
+    }
+    // Nets are numbered by smallest wire
+    FlatSize maxNet = 0;
+    for (FlatSize i=0; i<view.getNumFlatWires(); ++i) {
+        BOOST_CHECK (nets.getWireNet(i) <= maxNet);
+        maxNet = std::max(maxNet, nets.getWireNet(i) + 1);
+    }
+    // Both directions agree
+    for (FlatSize net=0; net<nets.getNumNets(); ++net) {
+        FlatRange range = nets.getPinRange(net);
+        BOOST_CHECK (range.second - range.first == 0 || range.second - range.first == 2);
+        for (FlatSize j=range.first; j<range.second; ++j) {
+            BOOST_CHECK_EQUAL (nets.getPinNet(nets.getNetPins()[j]), net);
+        }
+    }
+    for (FlatSize i=0; i<view.getNumFlatPorts(); ++i) {
+        FlatModulePort port = view.getFlatModulePortByIndex(i);
+        bool isPin = port.isTopPort() || port.getObject().getParentModule() == gate;
+        BOOST_CHECK_EQUAL (nets.getPinNet(i) != InvalidFlatIndex, isPin);
+    }
+    // Renumbering the view invalidates the nets
+    BOOST_CHECK (!nets.isStale());
+    top.createInstance(gate);
+    BOOST_CHECK (nets.isStale());
+}
+
+BOOST_AUTO_TEST_CASE(testHMetis) {
+    Module gate = Module::createLeaf();
+    Module mid = Module::createHier();
+    Module top = Module::createHier();
+    createBufferChain(gate, mid, top);
+    FlatView view(top);
+    FlatNets nets(view);
+
+    // The four buffers, connected in a chain; nets with a single buffer are not written
+    // Vertices follow the flat order: first buffer of both mids, then the second one
+    stringstream out;
+    writeHMetis(out, view, nets);
+    BOOST_CHECK_EQUAL (out.str(), "3 4\n2 3\n1 3\n2 4\n");
+
+    const ID weight = Symbol::ENUM_MAX_SYMBOL;
+    Module::InstanceIterator it = mid.instances().begin();
+    (*it).setAttribute(weight, 3);
+    stringstream weighted;
+    writeHMetis(weighted, view, nets, weight);
+    BOOST_CHECK_EQUAL (weighted.str(), "3 4 10\n2 3\n1 3\n2 4\n3\n3\n1\n1\n");
+    (*it).setAttribute(weight, -2);
+    stringstream clamped;
+    writeHMetis(clamped, view, nets, weight);
+    BOOST_CHECK_EQUAL (clamped.str(), "3 4 10\n2 3\n1 3\n2 4\n1\n1\n1\n1\n");
+    // Weights of the leaf module, such as the area of a cell, unless the instance overrides them
+    gate.setAttribute(weight, 5);
+    (*it).setAttribute(weight, 3);
+    stringstream moduleWeights;
+    writeHMetis(moduleWeights, view, nets, weight);
+    BOOST_CHECK_EQUAL (moduleWeights.str(), "3 4 10\n2 3\n1 3\n2 4\n3\n3\n5\n5\n");
+    gate.eraseAttribute(weight);
+
+    // Partitions map back to the leaf occurrences
+    vector<Size> parts;
+    stringstream partition("0\n1\n1\n0\n");
+    BOOST_CHECK (readHMetisPartition(partition, view, parts));
+    BOOST_CHECK_EQUAL (parts.size(), view.getNumFlatModules());
+    vector<Size> leafParts;
+    for (FlatSize i=0; i<view.getNumFlatModules(); ++i) {
+        if (view.getFlatModuleByIndex(i).getObject() == gate) {
+            leafParts.push_back(parts[i]);
+        }
+        else {
+            BOOST_CHECK_EQUAL (parts[i], InvalidIndex);
+        }
+    }
+    BOOST_CHECK (leafParts == vector<Size>({0, 1, 1, 0}));
+
+    stringstream tooShort("0\n1\n1\n");
+    BOOST_CHECK (!readHMetisPartition(tooShort, view, parts));
+    stringstream tooLong("0\n1\n1\n0\n1\n");
+    BOOST_CHECK (!readHMetisPartition(tooLong, view, parts));
+
+    // A leaf top module is not an instance: empty hypergraph
+    FlatView leafView(gate);
+    FlatNets leafNets(leafView);
+    stringstream leafOut;
+    writeHMetis(leafOut, leafView, leafNets, weight);
+    BOOST_CHECK_EQUAL (leafOut.str(), "0 0 10\n");
+    stringstream empty;
+    BOOST_CHECK (readHMetisPartition(empty, leafView, parts));
+    BOOST_CHECK (parts == vector<Size>({InvalidIndex}));
+}
+
+BOOST_AUTO_TEST_CASE(testLeafCensus) {
+    Module gate = Module::createLeaf();
+    Module mid = Module::createHier();
+    Module top = Module::createHier();
+    createBufferChain(gate, mid, top);
+    Module other = Module::createLeaf();
+    top.createInstance(other);
+    FlatView view(top);
+
+    LeafCensus census(view);
+    BOOST_CHECK_EQUAL (census.size(), 2u);
+    // In hierarchy order, where the leaf instanciated by the top module comes first
+    BOOST_CHECK (census.getModule(0) == other);
+    BOOST_CHECK_EQUAL (census.getCount(0), 1u);
+    BOOST_CHECK (census.getModule(1) == gate);
+    BOOST_CHECK_EQUAL (census.getCount(1), 4u);
+    BOOST_CHECK_EQUAL (census.getTotalCount(), 5u);
+
+    // Instance attributes take precedence over the module attribute
+    const ID areaAttr = Symbol::ENUM_MAX_SYMBOL;
+    gate.setAttribute(areaAttr, 2);
+    Module::InstanceIterator it = mid.instances().begin();
+    (*it).setAttribute(areaAttr, 3);
+    LeafCensus area(view, areaAttr);
+    BOOST_CHECK_EQUAL (area.getAttributeSum(0), 0);
+    BOOST_CHECK_EQUAL (area.getAttributeSum(1), 2*3 + 2*2);
+    BOOST_CHECK_EQUAL (area.getTotalAttributeSum(), 10);
+
+    // Same counts as a traversal of the flat instances
+    FlatSize numGates = 0;
+    for (FlatSize i=0; i<view.getNumFlatModules(); ++i) {
+        if (view.getFlatModuleByIndex(i).getObject() == gate) {
+            ++numGates;
+        }
+    }
+    BOOST_CHECK_EQUAL (census.getCount(1), numGates);
+
+    // The top module is not counted, even if it is a leaf
+    FlatView leafView(gate);
+    LeafCensus leafCensus(leafView, areaAttr);
+    BOOST_CHECK_EQUAL (leafCensus.size(), 0u);
+    BOOST_CHECK_EQUAL (leafCensus.getTotalCount(), 0u);
+    BOOST_CHECK_EQUAL (leafCensus.getTotalAttributeSum(), 0);
+    BOOST_CHECK (!census.isStale());
+    mid.createInstance(gate);
+    BOOST_CHECK (census.isStale());
+}
+
+BOOST_AUTO_TEST_CASE(testFlatSearch) {
+    const ID dontTouch = Symbol::ENUM_MAX_SYMBOL;
+    const ID vccName = Symbol::ENUM_MAX_SYMBOL + 1;
+    // Five modules without any symbol, and one with a marked gate and a named wire
+    Module gate = Module::createLeaf();
+    Module clean = Module::createHier();
+    Module marked = Module::createHier();
+    Module top = Module::createHier();
+    vector<Instance> firstGates;
+    for (Module mod : {clean, marked}) {
+        firstGates.push_back(mod.createInstance(gate));
+        for (int i=0; i<3; ++i) {
+            mod.createInstance(gate);
+        }
+        mod.createWire();
+    }
+    Instance markedGate = firstGates[1];
+    Instance cleanGate = firstGates[0];
+    markedGate.addProperty(dontTouch);
+    Module::WireIterator wireIt = marked.wires().begin();
+    (*wireIt).addName(vccName);
+    for (int i=0; i<5; ++i) {
+        top.createInstance(clean);
+    }
+    top.createInstance(marked);
+    FlatView view(top);
+    FlatSearch search(view);
+
+    // Only the top module and the marked module are visited
+    vector<FlatSize> found;
+    search.findInstancesWithProperty(dontTouch, found);
+    BOOST_CHECK_EQUAL (found.size(), 1u);
+    BOOST_CHECK (view.getFlatInstanceByIndex(found[0]).hasProperty(dontTouch));
+    BOOST_CHECK_EQUAL (search.getNumVisitedModules(), 2u);
+    search.findWiresWithName(vccName, found);
+    BOOST_CHECK_EQUAL (found.size(), 1u);
+    BOOST_CHECK (view.getFlatWireByIndex(found[0]).hasName(vccName));
+    BOOST_CHECK_EQUAL (search.getNumVisitedModules(), 2u);
+    search.findWiresWithProperty(dontTouch, found);
+    BOOST_CHECK_EQUAL (found.size(), 0u);
+    search.findInstancesWithName(vccName, found);
+    BOOST_CHECK_EQUAL (found.size(), 0u);
+
+    // Many distinct symbols in the clean module still prune it
+    for (int i=0; i<2000; ++i) {
+        Wire wire = clean.createWire();
+        wire.addName(vccName + 1 + i);
+        wire.addProperty(vccName + 1 + i);
+    }
+    search.findWiresWithName(vccName, found);
+    BOOST_CHECK_EQUAL (found.size(), 1u);
+    BOOST_CHECK_EQUAL (search.getNumVisitedModules(), 2u);
+    search.findInstancesWithProperty(dontTouch, found);
+    BOOST_CHECK_EQUAL (found.size(), 1u);
+    BOOST_CHECK_EQUAL (search.getNumVisitedModules(), 2u);
+    search.findWiresWithName(vccName + 2000, found);
+    BOOST_CHECK_EQUAL (found.size(), 5u);
+    BOOST_CHECK_EQUAL (search.getNumVisitedModules(), 6u);
+
+    // The summaries follow the edits
+    cleanGate.addProperty(dontTouch);
+    search.findInstancesWithProperty(dontTouch, found);
+    BOOST_CHECK_EQUAL (found.size(), 6u);
+    BOOST_CHECK_EQUAL (search.getNumVisitedModules(), 7u);
+    markedGate.eraseProperty(dontTouch);
+    cleanGate.eraseProperty(dontTouch);
+    search.findInstancesWithProperty(dontTouch, found);
+    BOOST_CHECK_EQUAL (found.size(), 0u);
+    BOOST_CHECK_EQUAL (search.getNumVisitedModules(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testFlatCones) {
+    Module gate = Module::createLeaf();
+    Module mid = Module::createHier();
+    Module top = Module::createHier();
+    createBufferChain(gate, mid, top);
+    for (Module mod : {gate, top}) {
+        Module::PortIterator it = mod.ports().begin();
+        (*it).setDirection(Symbol::DIR_IN);
+        ++it;
+        (*it).setDirection(Symbol::DIR_OUT);
+    }
+    FlatView view(top);
+    FlatNets nets(view);
+    FlatCones cones(view, nets);
+    BOOST_CHECK_EQUAL (cones.getNumNodes(), view.getNumFlatModules());
+
+    // The buffers in chain order, from their flat order (first buffer of both mids, then the second one)
+    FlatRange range = view.getFlatRange(gate);
+    vector<FlatSize> chain = {range.first, range.first + 2, range.first + 1, range.first + 3};
+    FlatSize topIndex = view.getTop().getIndex();
+    vector<vector<FlatSize> > fanOut, fanIn;
+    cones.getCones(chain, FlatCones::FanOut, fanOut);
+    cones.getCones(chain, FlatCones::FanIn, fanIn);
+    for (Size i=0; i<chain.size(); ++i) {
+        // The buffers after it, and the top module
+        vector<FlatSize> expected(chain.begin() + i, chain.end());
+        expected.push_back(topIndex);
+        sort(expected.begin(), expected.end());
+        BOOST_CHECK (fanOut[i] == expected);
+        expected.assign(chain.begin(), chain.begin() + i + 1);
+        expected.push_back(topIndex);
+        sort(expected.begin(), expected.end());
+        BOOST_CHECK (fanIn[i] == expected);
+    }
+
+    // One bit per source
+    vector<uint64_t> reached;
+    cones.propagate(chain, FlatCones::FanOut, reached);
+    BOOST_CHECK_EQUAL (reached[chain[0]], 1u);
+    BOOST_CHECK_EQUAL (reached[chain[3]], 15u);
+    BOOST_CHECK_EQUAL (reached[topIndex], 15u);
+
+    // The top module only continues the cone when it is a source
+    vector<FlatSize> cone;
+    cones.getCone({topIndex}, FlatCones::FanOut, cone);
+    BOOST_CHECK_EQUAL (cone.size(), 5u);
+    cones.getCone({chain[2], chain[3]}, FlatCones::FanOut, cone);
+    BOOST_CHECK_EQUAL (cone.size(), 3u);
+
+    // Larger batches than a word
+    vector<FlatSize> sources;
+    for (int i=0; i<100; ++i) {
+        sources.push_back(chain[i % 4]);
+    }
+    cones.getCones(sources, FlatCones::FanIn, fanIn);
+    for (Size i=0; i<sources.size(); ++i) {
+        BOOST_CHECK_EQUAL (fanIn[i].size(), i % 4 + 2);
+    }
+    BOOST_CHECK (!cones.isStale());
+    mid.createInstance(gate);
+    BOOST_CHECK (cones.isStale());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -3,10 +3,21 @@
 #include "gbl.hh"
 #include "gbl_symbols.hh"
 #include "gbl_flatview.hh"
+#include "gbl_hierarchy.hh"
+#include "gbl_design.hh"
+#include "gbl_algorithms.hh"
+#include "gbl_journal.hh"
+#include "gbl_concurrency.hh"
+#include "gbl_summaries.hh"
+#include "private/gbl_parallel.hh"
 
 #include <iostream>
 #include <algorithm>
 #include <random>
+#include <deque>
+#include <queue>
+#include <unordered_set>
+#include <thread>
 
 using namespace gbl;
 using namespace std;
@@ -189,6 +200,27 @@ class ModuleGenerator {
     float portDisconnectProb;
 };
 
+void checkSameFlatView(const FlatView& view, const FlatView& ref) {
+    BOOST_CHECK_EQUAL (view.getNumFlatModules(), ref.getNumFlatModules());
+    BOOST_CHECK_EQUAL (view.getNumFlatWires(), ref.getNumFlatWires());
+    BOOST_CHECK_EQUAL (view.getNumFlatPorts(), ref.getNumFlatPorts());
+    for (FlatSize i=1; i<view.getNumFlatModules(); ++i) {
+        FlatInstance inst = view.getFlatInstanceByIndex(i);
+        BOOST_CHECK (inst.getObject() == ref.getFlatInstanceByIndex(i).getObject());
+        BOOST_CHECK_EQUAL (inst.getIndex(), i);
+    }
+    for (FlatSize i=0; i<view.getNumFlatWires(); ++i) {
+        FlatWire wire = view.getFlatWireByIndex(i);
+        BOOST_CHECK (wire.getObject() == ref.getFlatWireByIndex(i).getObject());
+        BOOST_CHECK_EQUAL (wire.getIndex(), i);
+    }
+    for (FlatSize i=0; i<view.getNumFlatPorts(); ++i) {
+        FlatModulePort port = view.getFlatModulePortByIndex(i);
+        BOOST_CHECK (port.getObject() == ref.getFlatModulePortByIndex(i).getObject());
+        BOOST_CHECK_EQUAL (port.getIndex(), i);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE(NetlistTest)
 
 BOOST_AUTO_TEST_CASE(testBasicConstruction) {
@@ -344,6 +376,31 @@ BOOST_AUTO_TEST_CASE(testRandomConstruction) {
     gen.run();
 }
 
+BOOST_AUTO_TEST_CASE(testAttributes) {
+    Module hierMod = Module::createHier();
+    Module leafMod = Module::createLeaf();
+    Instance inst = hierMod.createInstance(leafMod);
+    Wire wire = hierMod.createWire();
+    ModulePort port = leafMod.createPort();
+
+    BOOST_CHECK (!inst.hasAttribute(Symbol::VCC));
+    BOOST_CHECK ( inst.setAttribute(Symbol::VCC, 3));
+    BOOST_CHECK (!inst.setAttribute(Symbol::VCC, 4));
+    BOOST_CHECK ( inst.hasAttribute(Symbol::VCC));
+    BOOST_CHECK_EQUAL (inst.getAttribute(Symbol::VCC), 4);
+    BOOST_CHECK ( inst.eraseAttribute(Symbol::VCC));
+    BOOST_CHECK (!inst.hasAttribute(Symbol::VCC));
+
+    BOOST_CHECK ( wire.setAttribute(Symbol::VSS, -1));
+    BOOST_CHECK_EQUAL (wire.getAttribute(Symbol::VSS), -1);
+    BOOST_CHECK ( wire.eraseAttribute(Symbol::VSS));
+
+    BOOST_CHECK (!port.hasAttribute(Symbol::VSS));
+    BOOST_CHECK ( port.setAttribute(Symbol::VSS, 1));
+    BOOST_CHECK_EQUAL (port.getAttribute(Symbol::VSS), 1);
+    BOOST_CHECK (!port.getUpPort(inst).hasAttribute(Symbol::VSS));
+}
+
 BOOST_AUTO_TEST_CASE(testRandomFlatView) {
     ModuleGenerator gen(1);
     gen.run();
@@ -376,5 +433,961 @@ BOOST_AUTO_TEST_CASE(testRandomFlatView) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(testFlatIds) {
+    ModuleGenerator gen(2);
+    gen.run();
+    FlatView view(gen.getModule());
+    BOOST_CHECK_EQUAL (sizeof(FlatWireId), sizeof(FlatSize));
+
+    BOOST_CHECK_EQUAL (view.nodeIds().size(), (std::int64_t) view.getNumFlatModules());
+    for (FlatNodeId id : view.nodeIds()) {
+        BOOST_CHECK (view.getFlatModule(id).getId() == id);
+        if (id.getIndex() != 0) {
+            BOOST_CHECK (view.getFlatInstance(id).getId() == id);
+        }
+    }
+    BOOST_CHECK_EQUAL (view.portIds().size(), (std::int64_t) view.getNumFlatPorts());
+    for (FlatPortId id : view.portIds()) {
+        BOOST_CHECK (view.getFlatModulePort(id).getId() == id);
+    }
+
+    // Breadth-first traversal of the flat connectivity with 8-byte worklist entries
+    std::vector<bool> visited(view.getNumFlatWires(), false);
+    FlatSize numVisited = 0;
+    for (FlatWireId start : view.wireIds()) {
+        BOOST_CHECK (view.getFlatWire(start).getId() == start);
+        if (visited[start.getIndex()]) continue;
+        std::deque<FlatWireId> queue(1, start);
+        visited[start.getIndex()] = true;
+        while (!queue.empty()) {
+            FlatWire wire = view.getFlatWire(queue.front());
+            queue.pop_front();
+            ++numVisited;
+            for (FlatPort port : wire.ports()) {
+                FlatPortId portId = port.getId();
+                // Cross the hierarchy through the port, in both directions
+                std::vector<FlatWireId> neighbours;
+                FlatModulePort modPort = view.getFlatModulePort(portId);
+                if (modPort.isConnected()) neighbours.push_back(modPort.getWire().getId());
+                if (!modPort.isTopPort()) {
+                    FlatInstancePort instPort = view.getFlatInstancePort(portId);
+                    if (instPort.isConnected()) neighbours.push_back(instPort.getWire().getId());
+                }
+                for (FlatWireId next : neighbours) {
+                    if (!visited[next.getIndex()]) {
+                        visited[next.getIndex()] = true;
+                        queue.push_back(next);
+                    }
+                }
+            }
+        }
+    }
+    BOOST_CHECK_EQUAL (numVisited, view.getNumFlatWires());
+
+    std::priority_queue<FlatPortId, std::vector<FlatPortId>, std::greater<FlatPortId> > heap;
+    for (FlatPortId id : view.portIds()) {
+        heap.push(id);
+    }
+    FlatSize expected = 0;
+    while (!heap.empty()) {
+        BOOST_CHECK_EQUAL (heap.top().getIndex(), expected++);
+        heap.pop();
+    }
+    std::unordered_set<FlatWireId> wireSet(view.wireIds().begin(), view.wireIds().end());
+    BOOST_CHECK_EQUAL (wireSet.size(), view.getNumFlatWires());
+}
+
+BOOST_AUTO_TEST_CASE(testParallelFlatView) {
+    ModuleGenerator gen(3);
+    gen.run();
+    internal::ThreadPool& pool = internal::ThreadPool::get();
+    unsigned numThreads = pool.getNumThreads();
+    bool random = pool.isRandomScheduling();
+    pool.setNumThreads(1);
+    FlatView serialView(gen.getModule());
+    for (unsigned threads : {2u, 3u, 8u}) {
+        pool.setNumThreads(threads);
+        pool.setRandomScheduling(threads == 3);
+        FlatView view(gen.getModule());
+        view.selfcheck();
+        BOOST_CHECK_EQUAL (view.getNumFlatModules(), serialView.getNumFlatModules());
+        BOOST_CHECK_EQUAL (view.getNumFlatWires(), serialView.getNumFlatWires());
+        BOOST_CHECK_EQUAL (view.getNumFlatPorts(), serialView.getNumFlatPorts());
+        for (FlatSize i=1; i<view.getNumFlatModules(); ++i) {
+            BOOST_CHECK (view.getFlatInstanceByIndex(i).getObject() == serialView.getFlatInstanceByIndex(i).getObject());
+        }
+        for (FlatSize i=0; i<view.getNumFlatWires(); ++i) {
+            BOOST_CHECK (view.getFlatWireByIndex(i).getObject() == serialView.getFlatWireByIndex(i).getObject());
+        }
+        for (FlatSize i=0; i<view.getNumFlatPorts(); ++i) {
+            BOOST_CHECK (view.getFlatModulePortByIndex(i).getObject() == serialView.getFlatModulePortByIndex(i).getObject());
+        }
+    }
+    pool.setNumThreads(numThreads);
+    pool.setRandomScheduling(random);
+}
+
+BOOST_AUTO_TEST_CASE(testIncrementalFlatView) {
+    ModuleGenerator gen(2);
+    gen.run();
+    Module top = gen.getModule();
+    FlatView view(top);
+    std::uint64_t epoch = view.getEpoch();
+
+    // Queries see the edits, and the epoch tells that the indexes changed
+    gen.createWires(3, 0.3);
+    BOOST_CHECK (view.getEpoch() != epoch);
+    epoch = view.getEpoch();
+    checkSameFlatView(view, FlatView(top));
+    BOOST_CHECK_EQUAL (view.getEpoch(), epoch);
+
+    gen.initPorts(3, 0.3);
+    checkSameFlatView(view, FlatView(top));
+    gen.createInstances(2, 0.3);
+    checkSameFlatView(view, FlatView(top));
+    BOOST_CHECK (view.getEpoch() != epoch);
+
+    // Modules entering and leaving the hierarchy
+    {
+        Module leaf = Module::createLeaf();
+        leaf.createPort();
+        leaf.createWire();
+        Instance inst = top.createInstance(leaf);
+        view.update();
+        checkSameFlatView(view, FlatView(top));
+        BOOST_CHECK_EQUAL (view.getNumFlatInstanciations(leaf), 1u);
+        inst.destroy();
+    }
+    checkSameFlatView(view, FlatView(top));
+    view.selfcheck();
+}
+
+BOOST_AUTO_TEST_CASE(testIncrementalFlatViewInstances) {
+    Module top = Module::createHier();
+    Module a = Module::createHier();
+    Module b = Module::createHier();
+    Module l = Module::createLeaf();
+    Module m = Module::createLeaf();
+    l.createPort();
+    m.createPort();
+    a.createWire();
+    b.createWire();
+    for (int i=0; i<2; ++i) {
+        top.createInstance(a);
+        top.createInstance(b);
+        a.createInstance(l);
+    }
+    top.createInstance(b);
+    b.createInstance(l);
+    b.createInstance(m);
+
+    // Order: top, b, m, a, l
+    FlatView view(top);
+    BOOST_CHECK_EQUAL (view.getNumRenumberedModules(), 5u);
+    top.createWire();
+    view.update();
+    BOOST_CHECK_EQUAL (view.getNumRenumberedModules(), 0u);
+
+    // Only the parents of the instanciated module change
+    Instance inst = b.createInstance(m);
+    view.update();
+    BOOST_CHECK_EQUAL (view.getNumRenumberedModules(), 1u);
+    checkSameFlatView(view, FlatView(top));
+    inst.destroy();
+    view.update();
+    BOOST_CHECK_EQUAL (view.getNumRenumberedModules(), 1u);
+    checkSameFlatView(view, FlatView(top));
+
+    // The subtree of the instanciated module is renumbered, not the rest of the hierarchy
+    inst = top.createInstance(b);
+    view.update();
+    BOOST_CHECK_EQUAL (view.getNumRenumberedModules(), 3u);
+    checkSameFlatView(view, FlatView(top));
+    inst.replaceModule(a);
+    view.update();
+    BOOST_CHECK_EQUAL (view.getNumRenumberedModules(), 4u);
+    checkSameFlatView(view, FlatView(top));
+
+    // A new module order renumbers everything
+    inst = a.createInstance(m);
+    view.update();
+    BOOST_CHECK_EQUAL (view.getNumRenumberedModules(), 5u);
+    checkSameFlatView(view, FlatView(top));
+
+    // Instances created in holes, destroyed in batches, and edits that cancel out
+    std::vector<Instance> instances;
+    for (int i=0; i<4; ++i) {
+        instances.push_back(top.createInstance(i % 2 == 0 ? a : b));
+        instances.push_back(b.createInstance(l));
+    }
+    view.update();
+    checkSameFlatView(view, FlatView(top));
+    instances[2].destroy();
+    instances[3].destroy();
+    top.destroyInstances({instances[4], instances[6]});
+    b.createInstance(m);
+    top.createInstance(b).destroy();
+    view.update();
+    BOOST_CHECK_EQUAL (view.getNumRenumberedModules(), 4u);
+    checkSameFlatView(view, FlatView(top));
+    view.selfcheck();
+}
+
+BOOST_AUTO_TEST_CASE(testHierarchyOrder) {
+    ModuleGenerator gen(3);
+    gen.run();
+    Module top = gen.getModule();
+    std::shared_ptr<const HierarchyOrder> order = HierarchyOrder::get(top);
+    BOOST_CHECK (order->isAcyclic());
+    BOOST_CHECK (order->isUpToDate());
+    BOOST_CHECK_EQUAL (order->size(), 5u);
+    BOOST_CHECK (order->getModule(0) == top);
+    for (Size i=0; i<order->size(); ++i) {
+        BOOST_CHECK_EQUAL (order->getIndex(order->getModule(i)), i);
+        for (Size child : order->getChildren(i)) {
+            BOOST_CHECK (child > i);
+        }
+    }
+    Module outside = Module::createLeaf();
+    BOOST_CHECK (!order->contains(outside));
+
+    // Shared until the instanciation graph changes
+    order = HierarchyOrder::get(top);
+    BOOST_CHECK (HierarchyOrder::get(top) == order);
+    gen.getModule(1).createWire();
+    BOOST_CHECK (HierarchyOrder::get(top) == order);
+    Instance inst = gen.getModule(1).createInstance(gen.getModule(4));
+    BOOST_CHECK (!order->isUpToDate());
+    std::shared_ptr<const HierarchyOrder> newOrder = HierarchyOrder::get(top);
+    BOOST_CHECK (newOrder != order);
+    BOOST_CHECK (newOrder->isUpToDate());
+    inst.destroy();
+
+    // Cycles are reported
+    Module a = Module::createHier();
+    Module b = Module::createHier();
+    Module c = Module::createHier();
+    a.createInstance(b);
+    b.createInstance(c);
+    FlatView view(a);
+    BOOST_CHECK_EQUAL (view.getNumFlatModules(), 3u);
+    Instance loop = c.createInstance(b);
+    HierarchyOrder cyclic(a);
+    BOOST_CHECK (!cyclic.isAcyclic());
+    BOOST_CHECK_EQUAL (cyclic.size(), 0u);
+    std::vector<Module> cycle = cyclic.getCycle();
+    BOOST_CHECK_EQUAL (cycle.size(), 2u);
+    BOOST_CHECK (cycle[0] == b && cycle[1] == c);
+    // Flat views of a cyclic hierarchy are empty until the cycle is broken
+    BOOST_CHECK (view.hasCycle());
+    BOOST_CHECK_EQUAL (view.getNumFlatModules(), 0u);
+    BOOST_CHECK (FlatView(a).hasCycle());
+    loop.destroy();
+    BOOST_CHECK (HierarchyOrder(a).isAcyclic());
+    BOOST_CHECK (!view.hasCycle());
+    BOOST_CHECK_EQUAL (view.getNumFlatModules(), 3u);
+
+    // Deep hierarchies don't overflow the stack
+    std::vector<Module> chain;
+    chain.push_back(Module::createLeaf());
+    for (int i=0; i<100000; ++i) {
+        Module mod = Module::createHier();
+        mod.createInstance(chain.back());
+        chain.push_back(mod);
+    }
+    HierarchyOrder deep(chain.back());
+    BOOST_CHECK_EQUAL (deep.size(), chain.size());
+    BOOST_CHECK (deep.getModule(deep.size()-1) == chain.front());
+}
+
+BOOST_AUTO_TEST_CASE(testDesign) {
+    Module kept;
+    {
+        Design design;
+        Module top = design.createHier();
+        std::vector<Module> mods;
+        for (int i=0; i<100; ++i) {
+            Module mod = i % 2 ? design.createLeaf() : design.createHier();
+            top.createInstance(mod);
+            for (int j=0; j<i; ++j) {
+                mod.createWire();
+            }
+            mods.push_back(mod);
+        }
+        BOOST_CHECK_EQUAL (design.getNumModules(), 101u);
+        for (Size id=0; id<design.getNumModules(); ++id) {
+            BOOST_CHECK_EQUAL (design.getId(design.getModule(id)), id);
+        }
+        BOOST_CHECK (design.getModule(0) == top);
+
+        // Whole-design passes
+        std::vector<Size> numWires(design.getNumModules(), InvalidIndex);
+        design.parallelForEachModule([&](Module mod) {
+            numWires[design.getId(mod)] = mod.wires().size();
+        });
+        for (Size id=0; id<design.getNumModules(); ++id) {
+            BOOST_CHECK_EQUAL (numWires[id], (Size) design.getModule(id).wires().size());
+        }
+
+        // Identifiers stay dense
+        Module removed = design.createLeaf();
+        Module last = design.createLeaf();
+        design.remove(removed);
+        BOOST_CHECK (!design.contains(removed));
+        BOOST_CHECK_EQUAL (design.getNumModules(), 102u);
+        BOOST_CHECK_EQUAL (design.getId(last), 101u);
+        Design other;
+        other.add(removed);
+        BOOST_CHECK_EQUAL (other.getId(removed), 0u);
+
+        kept = mods[20];
+    }
+    // Still referenced after the design is gone
+    BOOST_CHECK (kept.isValid());
+    BOOST_CHECK_EQUAL (kept.wires().size(), 20);
+}
+
+BOOST_AUTO_TEST_CASE(testParallelForEach) {
+    Module top = Module::createHier();
+    Module leaf = Module::createLeaf();
+    for (int i=0; i<4; ++i) {
+        leaf.createPort();
+    }
+    std::mt19937 rengine(1);
+    std::vector<Instance> instances;
+    std::vector<Wire> wires;
+    for (int i=0; i<20000; ++i) {
+        instances.push_back(top.createInstance(leaf));
+        wires.push_back(top.createWire());
+    }
+    // Mostly empty regions, to check the balancing
+    for (int i=0; i<20000; ++i) {
+        if (i < 15000 ? rengine() % 16 != 0 : rengine() % 4 == 0) {
+            instances[i].destroy();
+            wires[i].destroy();
+        }
+    }
+
+    std::vector<std::atomic<int> > nodeVisits(top.nodes().size() + 20000);
+    parallelForEach(top.instances(), [&](Instance inst) {
+        ++nodeVisits[inst.ref()._ind];
+    });
+    std::vector<std::atomic<int> > wireVisits(20000);
+    parallelForEach(top.wires(), [&](Wire wire) {
+        ++wireVisits[wire.ref()._ind];
+    });
+    for (int i=0; i<20000; ++i) {
+        BOOST_CHECK_EQUAL (nodeVisits[i+1], instances[i].isValid() ? 1 : 0);
+        BOOST_CHECK_EQUAL (wireVisits[i], wires[i].isValid() ? 1 : 0);
+    }
+    BOOST_CHECK_EQUAL (nodeVisits[0], 0);
+
+    // Chunks follow the occupancy, not the index range
+    std::vector<Size> bounds;
+    Size numWires = top.wires().size();
+    internal::getBalancedChunks(0, 20000, &top.ref()._ptr->_wires.blockUsed(), bounds);
+    BOOST_CHECK (bounds.size() > 2);
+    for (Size i=0; i+2<bounds.size(); ++i) {
+        Size count = 0;
+        for (Size j=bounds[i]; j<bounds[i+1]; ++j) {
+            count += wires[j].isValid() ? 1 : 0;
+        }
+        BOOST_CHECK (count >= internal::getDefaultGrain(numWires));
+    }
+
+    std::atomic<int> numPorts(0);
+    Module::InstanceIterator it = top.instances().begin();
+    Instance inst = *it;
+    parallelForEach(inst.ports(), [&](InstancePort port) {
+        if (port.getInstance() == inst) {
+            ++numPorts;
+        }
+    });
+    BOOST_CHECK_EQUAL (numPorts, 4);
+}
+
+BOOST_AUTO_TEST_CASE(testLazyFlatView) {
+    ModuleGenerator gen(3);
+    gen.run();
+    Module top = gen.getModule();
+    FlatView eagerView(top);
+    FlatView lazyView(top, true);
+    Size numMods = eagerView.getNumMaterializedModules();
+    BOOST_CHECK_EQUAL (numMods, 5u);
+    BOOST_CHECK_EQUAL (lazyView.getNumMaterializedModules(), 0u);
+
+    // Counts and module navigation don't need the tables
+    BOOST_CHECK_EQUAL (lazyView.getNumFlatWires(), eagerView.getNumFlatWires());
+    BOOST_CHECK_EQUAL (lazyView.getNumFlatPorts(), eagerView.getNumFlatPorts());
+    for (FlatSize i=1; i<lazyView.getNumFlatModules(); ++i) {
+        BOOST_CHECK_EQUAL (lazyView.getFlatInstanceByIndex(i).getIndex(), i);
+    }
+    BOOST_CHECK_EQUAL (lazyView.getNumMaterializedModules(), 0u);
+
+    // Only the module that is touched is built
+    FlatWire wire = lazyView.getFlatWireByIndex(lazyView.getNumFlatWires() - 1);
+    BOOST_CHECK_EQUAL (lazyView.getNumMaterializedModules(), 1u);
+    BOOST_CHECK (wire.getObject() == eagerView.getFlatWireByIndex(eagerView.getNumFlatWires() - 1).getObject());
+
+    // Concurrent first touch
+    std::vector<FlatSize> indexes(lazyView.getNumFlatPorts());
+    internal::parallelFor(0, indexes.size(), [&](Size i) {
+        indexes[i] = lazyView.getFlatModulePortByIndex(i).getIndex();
+    });
+    for (Size i=0; i<indexes.size(); ++i) {
+        BOOST_CHECK_EQUAL (indexes[i], i);
+    }
+    BOOST_CHECK_EQUAL (lazyView.getNumMaterializedModules(), numMods);
+    checkSameFlatView(lazyView, eagerView);
+
+    // Edited modules are built again on demand
+    gen.getModule(1).createWire();
+    BOOST_CHECK_EQUAL (lazyView.getNumMaterializedModules(), numMods - 1);
+    checkSameFlatView(lazyView, eagerView);
+    lazyView.selfcheck();
+}
+
+BOOST_AUTO_TEST_CASE(testEditJournals) {
+    Module leaf = Module::createLeaf();
+    leaf.createPort();
+    leaf.createPort();
+    Module top = Module::createHier();
+    std::vector<Wire> wires;
+    for (int i=0; i<10; ++i) {
+        wires.push_back(top.createWire());
+    }
+    Instance removed = top.createInstance(leaf);
+    Instance::PortIterator removedPort = removed.ports().begin();
+    (*removedPort).connect(wires[9]);
+
+    // Each journal connects a new instance to its own existing wire and to a new wire
+    std::vector<EditJournal> journals(8, EditJournal(top));
+    std::vector<JournalNode> created(8, JournalNode(removed));
+    internal::parallelFor(0, journals.size(), 1, [&](Size i) {
+        JournalNode inst = journals[i].createInstance(leaf);
+        JournalWire wire = journals[i].createWire();
+        journals[i].connect(inst, 0, wires[i]);
+        journals[i].connect(inst, 1, wire);
+        created[i] = inst;
+    });
+    // Conflicts with the journal 3
+    journals.emplace_back(top);
+    journals.back().connect(journals.back().createInstance(leaf), 0, wires[3]);
+    // Destroys an instance and its wire
+    journals.emplace_back(top);
+    journals.back().destroy(removed);
+    journals.back().destroy(wires[9]);
+
+    EditJournal::merge(journals);
+    BOOST_CHECK (journals[8].isRejected());
+    BOOST_CHECK (journals[9].isMerged());
+    BOOST_CHECK_EQUAL (top.instances().size(), 8);
+    BOOST_CHECK_EQUAL (top.wires().size(), 17);
+    for (Size i=0; i<8; ++i) {
+        BOOST_CHECK (journals[i].isMerged());
+        Instance inst = journals[i].getInstance(created[i]);
+        BOOST_CHECK (inst.getDownModule() == leaf);
+        BOOST_CHECK_EQUAL (wires[i].ports().size(), 1);
+        Wire::PortIterator port = wires[i].ports().begin();
+        BOOST_CHECK ((*port).getNode() == inst);
+        // Instances are created in the order of the journals
+        BOOST_CHECK_EQUAL (inst.ref()._ind, journals[0].getInstance(created[0]).ref()._ind + i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testConcurrentEdits) {
+    ModuleGenerator gen(3);
+    gen.run();
+    Module top = gen.getModule();
+    Module shared = gen.getModule(3);
+    FlatView ref(top);
+    FlatSize numFlatWires = ref.getNumFlatWires();
+    FlatSize numFlatPorts = ref.getNumFlatPorts();
+
+    // Flat views of a hierarchy, while other modules instanciate part of it and are edited
+    std::atomic<bool> done(false);
+    std::atomic<int> numErrors(0);
+    std::vector<std::thread> threads;
+    for (int t=0; t<2; ++t) {
+        threads.emplace_back([&]() {
+            while (!done) {
+                FlatView view(top);
+                if (view.getNumFlatWires() != numFlatWires || view.getNumFlatPorts() != numFlatPorts) {
+                    ++numErrors;
+                }
+                for (FlatSize i=0; i<view.getNumFlatWires(); i += 7) {
+                    if (view.getFlatWireByIndex(i).getObject() != ref.getFlatWireByIndex(i).getObject()) {
+                        ++numErrors;
+                    }
+                }
+            }
+        });
+    }
+    std::vector<std::thread> editors;
+    for (int t=0; t<4; ++t) {
+        editors.emplace_back([&]() {
+            Module mod = Module::createHier();
+            for (int i=0; i<200; ++i) {
+                Wire wire = mod.createWire();
+                Instance inst = mod.createInstance(shared);
+                for (Port port : inst.ports()) {
+                    port.connect(wire);
+                }
+                if (i % 3 == 0) {
+                    inst.destroy();
+                }
+                if (i % 5 == 0) {
+                    wire.destroy();
+                }
+            }
+            if (mod.instances().size() != 133 || mod.wires().size() != 160) {
+                ++numErrors;
+            }
+        });
+    }
+    for (std::thread& editor : editors) {
+        editor.join();
+    }
+    done = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL (numErrors, 0);
+
+    // Writers of the same module are serialized, and readers never see an odd version
+    Module common = Module::createHier();
+    std::uint64_t initVersion = getModuleVersion(common);
+    threads.clear();
+    for (int t=0; t<2; ++t) {
+        threads.emplace_back([&]() {
+            for (int i=0; i<500; ++i) {
+                ModuleWriteGuard guard(common);
+                common.createWire();
+            }
+        });
+    }
+    threads.emplace_back([&]() {
+        for (int i=0; i<500; ++i) {
+            ModuleReadSection section(common);
+            if (section.getVersion() % 2 != 0) {
+                ++numErrors;
+            }
+        }
+    });
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL (numErrors, 0);
+    BOOST_CHECK_EQUAL (common.wires().size(), 1000);
+    BOOST_CHECK_EQUAL (getModuleVersion(common), initVersion + 4000);
+
+    // Torn reads are detected
+    ModuleReadSection section(common);
+    BOOST_CHECK (section.validate());
+    common.createWire();
+    BOOST_CHECK (!section.validate());
+    section.restart();
+    BOOST_CHECK (section.validate());
+
+    // Connections and data are edits too, although the observers are not told
+    Wire wire = common.createWire();
+    ModulePort port = common.createPort();
+    section.restart();
+    port.connect(wire);
+    BOOST_CHECK (!section.validate());
+    section.restart();
+    wire.setAttribute(Symbol::ENUM_MAX_SYMBOL, 1);
+    BOOST_CHECK (!section.validate());
+    section.restart();
+    port.disconnect();
+    BOOST_CHECK (!section.validate());
+}
+
+BOOST_AUTO_TEST_CASE(testReplaceModule) {
+    // Same ports in a different order, with one more port and one less
+    Module small = Module::createLeaf();
+    Module large = Module::createLeaf();
+    for (ID name : {1, 2, 3}) {
+        small.createPort().addName(name);
+    }
+    for (ID name : {4, 3, 2, 1}) {
+        large.createPort().addName(name);
+    }
+    Module top = Module::createHier();
+    Instance inst = top.createInstance(small);
+    inst.addName(10);
+    std::vector<Wire> wires;
+    for (Port port : inst.ports()) {
+        wires.push_back(top.createWire());
+        port.connect(wires.back());
+    }
+    Instance other = top.createInstance(small);
+    FlatView view(top);
+    BOOST_CHECK_EQUAL (view.getNumFlatPorts(), 6u);
+
+    // By name: the connections follow the names
+    std::vector<Size> mapping = small.getPortMappingByName(large);
+    BOOST_CHECK (mapping == std::vector<Size>({3, 2, 1}));
+    Node before = inst;
+    inst.replaceModule(large, mapping);
+    BOOST_CHECK (Node(inst) == before);
+    BOOST_CHECK (inst.hasName(10));
+    BOOST_CHECK (inst.getDownModule() == large);
+    for (InstancePort port : inst.ports()) {
+        if (port.getDownPort().hasName(4)) {
+            BOOST_CHECK (!port.isConnected());
+        }
+        else {
+            BOOST_CHECK (port.isConnected());
+            BOOST_CHECK (port.getWire() == wires[4 - port.ref()._portInd - 1]);
+            Wire::PortIterator wirePort = port.getWire().ports().begin();
+            BOOST_CHECK (*wirePort == port);
+        }
+    }
+    BOOST_CHECK_EQUAL (view.getNumFlatPorts(), 7u);
+
+    // By index: the port without a counterpart is disconnected
+    inst.replaceModule(small);
+    BOOST_CHECK (inst.getDownModule() == small);
+    BOOST_CHECK_EQUAL (wires[0].ports().size(), 0);
+    BOOST_CHECK_EQUAL (wires[2].ports().size(), 1);
+    other.replaceModule(large);
+    BOOST_CHECK_EQUAL (view.getNumFlatPorts(), 7u);
+    view.selfcheck();
+}
+
+BOOST_AUTO_TEST_CASE(testCompactPorts) {
+    Design design;
+    Module leaf = design.createHier();
+    std::vector<ModulePort> ports;
+    for (int i=0; i<8; ++i) {
+        ports.push_back(leaf.createPort());
+        ports.back().addName(i);
+        ports.back().connect(leaf.createWire());
+    }
+    std::vector<Module> parents;
+    std::vector<Instance> instances;
+    for (int p=0; p<20; ++p) {
+        Module parent = design.createHier();
+        for (int i=0; i<10; ++i) {
+            Instance inst = parent.createInstance(leaf);
+            for (Port port : inst.ports()) {
+                Wire wire = parent.createWire();
+                wire.setAttribute(0, port.ref()._portInd);
+                port.connect(wire);
+                port.setAttribute(1, port.ref()._portInd);
+            }
+            instances.push_back(inst);
+        }
+        parents.push_back(parent);
+    }
+    Module unrelated = design.createHier();
+    unrelated.createWire();
+    ports[2].destroy();
+    ports[5].destroy();
+    ports[6].destroy();
+
+    std::uint64_t parentVersion = getModuleVersion(parents[0]);
+    std::uint64_t unrelatedVersion = getModuleVersion(unrelated);
+    std::vector<Size> mapping = design.compactPorts(leaf);
+    // Parents whose instances were renumbered are edited, the others are not
+    BOOST_CHECK (getModuleVersion(parents[0]) != parentVersion);
+    BOOST_CHECK_EQUAL (getModuleVersion(unrelated), unrelatedVersion);
+    BOOST_CHECK (mapping == std::vector<Size>({0, 1, InvalidIndex, 2, 3, InvalidIndex, InvalidIndex, 4}));
+    BOOST_CHECK_EQUAL (leaf.ports().size(), 5);
+    for (ModulePort port : leaf.ports()) {
+        BOOST_CHECK (port.ref()._portInd < 5u);
+        Wire::PortIterator wirePort = port.getWire().ports().begin();
+        BOOST_CHECK (*wirePort == port);
+    }
+    for (Instance inst : instances) {
+        Size numPorts = 0;
+        for (InstancePort port : inst.ports()) {
+            ++numPorts;
+            // Names come from the module port, the rest from the instance port and its wire
+            Size oldInd = port.getDownPort().names().begin()[0];
+            BOOST_CHECK_EQUAL (mapping[oldInd], port.ref()._portInd);
+            BOOST_CHECK_EQUAL (port.getAttribute(1), (std::int64_t) oldInd);
+            BOOST_CHECK_EQUAL (port.getWire().getAttribute(0), (std::int64_t) oldInd);
+            Wire::PortIterator wirePort = port.getWire().ports().begin();
+            BOOST_CHECK (*wirePort == port);
+        }
+        BOOST_CHECK_EQUAL (numPorts, 5u);
+    }
+    // Already compact
+    BOOST_CHECK (design.compactPorts(leaf) == std::vector<Size>({0, 1, 2, 3, 4}));
+    leaf.createPort();
+    BOOST_CHECK_EQUAL (leaf.ports().size(), 6);
+}
+
+BOOST_AUTO_TEST_CASE(testMergeSplitWires) {
+    Module leaf = Module::createLeaf();
+    leaf.createPort();
+    leaf.createPort();
+    Module top = Module::createHier();
+    top.createPort();
+    Wire a = top.createWire();
+    Wire b = top.createWire();
+    std::vector<Port> portsA, portsB;
+    Module::PortIterator topPort = top.ports().begin();
+    (*topPort).connect(a);
+    portsA.push_back(*topPort);
+    for (int i=0; i<50; ++i) {
+        Instance inst = top.createInstance(leaf);
+        Instance::PortIterator it = inst.ports().begin();
+        Port p0 = *it;
+        ++it;
+        Port p1 = *it;
+        p0.connect(a);
+        p1.connect(b);
+        portsA.push_back(p0);
+        portsB.push_back(p1);
+    }
+    // Holes in both the target and the source list
+    for (int i=1; i<50; i += 7) {
+        portsA[i].disconnect();
+    }
+    std::vector<Port> connectedB;
+    for (int i=0; i<50; ++i) {
+        if (i % 7 == 3) {
+            portsB[i].disconnect();
+        }
+        else {
+            connectedB.push_back(portsB[i]);
+        }
+    }
+    portsB = connectedB;
+
+    b.mergeInto(a);
+    BOOST_CHECK (!b.isValid());
+    Size numConnected = 0;
+    for (Port port : a.ports()) {
+        BOOST_CHECK (port.getWire() == a);
+        ++numConnected;
+    }
+    BOOST_CHECK_EQUAL (numConnected, 51u - 7u + 43u);
+    for (Port port : portsB) {
+        BOOST_CHECK (port.getWire() == a);
+    }
+
+    // Split the ports of B back
+    std::uint64_t version = getModuleVersion(top);
+    Wire c = a.split(portsB);
+    BOOST_CHECK (getModuleVersion(top) != version);
+    BOOST_CHECK_EQUAL (c.ports().size(), 43);
+    BOOST_CHECK_EQUAL (a.ports().size(), 44);
+    for (Port port : portsB) {
+        BOOST_CHECK (port.getWire() == c);
+    }
+    for (Port port : c.ports()) {
+        BOOST_CHECK (std::find(portsB.begin(), portsB.end(), port) != portsB.end());
+    }
+    FlatView view(top);
+    view.selfcheck();
+}
+
+BOOST_AUTO_TEST_CASE(testBatchDestruction) {
+    // Same netlist, edited object by object or in batch
+    ModuleGenerator gen1(1, 3), gen2(1, 3);
+    gen1.run();
+    gen2.run();
+    Module mod1 = gen1.getModule();
+    Module mod2 = gen2.getModule();
+    std::vector<Instance> instances;
+    std::vector<Wire> wires;
+    for (Instance inst : mod1.instances()) {
+        if (inst.ref()._ind % 3 == 0) {
+            instances.push_back(Instance(Node(mod2.ref()._ptr, inst.ref()._ind)));
+            inst.destroy();
+        }
+    }
+    for (Wire wire : mod1.wires()) {
+        if (wire.ref()._ind % 2 == 0) {
+            wires.push_back(Wire(mod2.ref()._ptr, wire.ref()._ind));
+            wire.destroy();
+        }
+    }
+    BOOST_CHECK (!instances.empty());
+    BOOST_CHECK (!wires.empty());
+    mod2.destroyInstances(instances);
+    mod2.destroyWires(wires);
+
+    BOOST_CHECK_EQUAL (mod1.instances().size(), mod2.instances().size());
+    BOOST_CHECK_EQUAL (mod1.wires().size(), mod2.wires().size());
+    for (Node node : mod1.nodes()) {
+        Node other(mod2.ref()._ptr, node.ref()._ind);
+        BOOST_CHECK (other.isValid());
+        for (Port port : node.ports()) {
+            Port otherPort(mod2.ref()._ptr, port.ref()._instInd, port.ref()._portInd);
+            BOOST_CHECK_EQUAL (port.isConnected(), otherPort.isConnected());
+            if (port.isConnected()) {
+                BOOST_CHECK_EQUAL (port.getWire().ref()._ind, otherPort.getWire().ref()._ind);
+            }
+        }
+    }
+    for (Wire wire : mod2.wires()) {
+        for (Port port : wire.ports()) {
+            BOOST_CHECK (port.isValid());
+            BOOST_CHECK (port.getWire() == wire);
+        }
+    }
+    FlatView view(mod2);
+    view.selfcheck();
+}
+
+BOOST_AUTO_TEST_CASE(testDrivers) {
+    Module gate = Module::createLeaf();
+    ModulePort a = gate.createPort();
+    ModulePort y = gate.createPort();
+    a.setDirection(Symbol::DIR_IN);
+    y.addProperty(Symbol::DIR_OUT);
+    BOOST_CHECK_EQUAL (a.getDirection(), (ID) Symbol::DIR_IN);
+    BOOST_CHECK_EQUAL (y.getDirection(), (ID) Symbol::DIR_OUT);
+    BOOST_CHECK (a.hasProperty(Symbol::DIR_IN));
+
+    // A chain of gates between an input and an output of the top module
+    Module top = Module::createHier();
+    ModulePort in = top.createPort();
+    ModulePort out = top.createPort();
+    in.setDirection(Symbol::DIR_IN);
+    out.setDirection(Symbol::DIR_OUT);
+    std::vector<Wire> wires;
+    std::vector<Instance> gates;
+    wires.push_back(top.createWire());
+    in.connect(wires.back());
+    for (int i=0; i<10; ++i) {
+        Instance inst = top.createInstance(gate);
+        InstancePort instA = a.getUpPort(inst);
+        InstancePort instY = y.getUpPort(inst);
+        BOOST_CHECK_EQUAL (instY.getDirection(), (ID) Symbol::DIR_OUT);
+        instA.connect(wires.back());
+        wires.push_back(top.createWire());
+        instY.connect(wires.back());
+        gates.push_back(inst);
+    }
+    out.connect(wires.back());
+
+    BOOST_CHECK (wires[0].getDriver() == in);
+    for (int i=0; i<10; ++i) {
+        BOOST_CHECK (wires[i+1].getDriver() == y.getUpPort(gates[i]));
+        Size numLoads = 0;
+        for (Port load : wires[i].loads()) {
+            BOOST_CHECK (load == a.getUpPort(gates[i]));
+            ++numLoads;
+        }
+        BOOST_CHECK_EQUAL (numLoads, 1u);
+    }
+    Size numLoads = 0;
+    for (Port load : wires[10].loads()) {
+        BOOST_CHECK (load == out);
+        ++numLoads;
+    }
+    BOOST_CHECK_EQUAL (numLoads, 1u);
+
+    // Connection edits
+    Port driver = wires[5].getDriver();
+    driver.disconnect();
+    BOOST_CHECK (!wires[5].getDriver().isValid());
+    BOOST_CHECK_EQUAL (wires[5].loads().size(), 1);
+    driver.connect(wires[5]);
+    BOOST_CHECK (wires[5].getDriver() == driver);
+    // Multiple drivers: the other ones are listed with the loads
+    wires[6].mergeInto(wires[5]);
+    BOOST_CHECK (wires[5].getDriver() == driver);
+    BOOST_CHECK_EQUAL (wires[5].loads().size(), 3);
+
+    // Direction edits are seen through all the instances
+    y.setDirection(Symbol::DIR_IN);
+    a.addProperty(Symbol::DIR_OUT);
+    BOOST_CHECK (wires[0].getDriver() == in);
+    BOOST_CHECK (wires[1].getDriver() == a.getUpPort(gates[1]));
+    BOOST_CHECK_EQUAL (wires[10].loads().size(), 2);
+    // The DIR_* properties of a module port give its direction
+    BOOST_CHECK (y.hasProperty(Symbol::DIR_IN) && !y.hasProperty(Symbol::DIR_OUT));
+    BOOST_CHECK (a.hasProperty(Symbol::DIR_IN) && a.hasProperty(Symbol::DIR_OUT));
+    BOOST_CHECK (a.eraseProperty(Symbol::DIR_OUT));
+    BOOST_CHECK_EQUAL (a.getDirection(), (ID) Symbol::DIR_IN);
+    BOOST_CHECK (a.eraseProperty(Symbol::DIR_IN));
+    BOOST_CHECK_EQUAL (a.getDirection(), 0u);
+    BOOST_CHECK (!wires[1].getDriver().isValid());
+    // Instance port properties do not change the direction
+    a.getUpPort(gates[1]).addProperty(Symbol::DIR_OUT);
+    BOOST_CHECK_EQUAL (a.getUpPort(gates[1]).getDirection(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testModuleSummaries) {
+    // Three gates in each mid, two mids and a gate in the top module
+    Module gate = Module::createLeaf();
+    gate.createPort();
+    Module mid = Module::createHier();
+    Module top = Module::createHier();
+    for (int i=0; i<3; ++i) {
+        mid.createInstance(gate);
+    }
+    top.createInstance(mid);
+    top.createInstance(mid);
+    Instance topGate = top.createInstance(gate);
+
+    // Number of leaf occurrences, with the area of the leaves as an attribute
+    const ID areaAttr = Symbol::ENUM_MAX_SYMBOL;
+    gate.setAttribute(areaAttr, 2);
+    struct Census {
+        std::int64_t _numLeaves;
+        std::int64_t _area;
+    };
+    ModuleSummaries<Census> census([&](Module module, const ModuleSummaries<Census>& summaries) {
+        if (module.isLeaf()) {
+            return Census{1, module.getAttribute(areaAttr)};
+        }
+        Census ret = {0, 0};
+        for (Instance inst : module.instances()) {
+            const Census& child = summaries.getChild(inst.getDownModule());
+            ret._numLeaves += child._numLeaves;
+            ret._area += child._area;
+        }
+        return ret;
+    });
+    BOOST_CHECK_EQUAL (census.get(top)->_numLeaves, 7);
+    BOOST_CHECK_EQUAL (census.get(top)->_area, 14);
+    BOOST_CHECK_EQUAL (census.getNumEvaluations(), 3u);
+
+    // Only the edited module and the modules above it are evaluated again
+    Wire wire = top.createWire();
+    BOOST_CHECK_EQUAL (census.get(top)->_numLeaves, 7);
+    BOOST_CHECK_EQUAL (census.getNumEvaluations(), 4u);
+    Instance::PortIterator portIt = topGate.ports().begin();
+    (*portIt).connect(wire);
+    census.get(top);
+    BOOST_CHECK_EQUAL (census.getNumEvaluations(), 5u);
+    BOOST_CHECK_EQUAL (census.get(mid)->_numLeaves, 3);
+    BOOST_CHECK_EQUAL (census.getNumEvaluations(), 5u);
+
+    mid.createInstance(gate);
+    BOOST_CHECK_EQUAL (census.get(top)->_numLeaves, 9);
+    BOOST_CHECK_EQUAL (census.getNumEvaluations(), 7u);
+    gate.setAttribute(areaAttr, 3);
+    BOOST_CHECK_EQUAL (census.get(top)->_area, 27);
+    BOOST_CHECK_EQUAL (census.getNumEvaluations(), 10u);
+
+    // Larger hierarchies give the same result as a flat traversal
+    ModuleGenerator gen(4);
+    gen.run();
+    ModuleSummaries<FlatSize> numInstances([](Module module, const ModuleSummaries<FlatSize>& summaries) {
+        FlatSize ret = 1;
+        for (Instance inst : module.instances()) {
+            ret += summaries.getChild(inst.getDownModule());
+        }
+        return ret;
+    });
+    FlatView view(gen.getModule());
+    BOOST_CHECK_EQUAL (*numInstances.get(gen.getModule()), view.getNumFlatModules());
+
+    // No summary for a cyclic hierarchy
+    Instance loop = mid.createInstance(top);
+    BOOST_CHECK (census.get(top) == nullptr);
+    loop.destroy();
+    BOOST_CHECK_EQUAL (census.get(top)->_numLeaves, 9);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,107 @@
+#include "testing.hh"
+#include "private/gbl_parallel.hh"
+
+#include <random>
+#include <cmath>
+
+using namespace gbl;
+using namespace gbl::internal;
+using namespace std;
+
+namespace {
+// Runs f with each thread count, with and without randomized scheduling
+template<class F>
+void forEachSchedule(F f) {
+    ThreadPool& pool = ThreadPool::get();
+    unsigned numThreads = pool.getNumThreads();
+    bool random = pool.isRandomScheduling();
+    for (bool rand : {false, true}) {
+        pool.setRandomScheduling(rand);
+        for (unsigned threads : {1u, 2u, 3u, 8u}) {
+            pool.setNumThreads(threads);
+            f();
+        }
+    }
+    pool.setNumThreads(numThreads);
+    pool.setRandomScheduling(random);
+}
+
+Size fibonacci(Size n) {
+    if (n < 2) return n;
+    Size a = 0;
+    TaskGroup group;
+    group.run([&]() { a = fibonacci(n-1); });
+    Size b = fibonacci(n-2);
+    group.wait();
+    return a + b;
+}
+} // End anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ParallelTest)
+
+BOOST_AUTO_TEST_CASE(testParallelFor) {
+    forEachSchedule([]() {
+        for (Size n : {0u, 1u, 7u, 1000u, 100000u}) {
+            std::vector<std::atomic<int> > visits(n);
+            parallelFor(0, n, [&](Size i) {
+                ++visits[i];
+            });
+            bool ok = true;
+            for (Size i=0; i<n; ++i) {
+                ok = ok && visits[i] == 1;
+            }
+            BOOST_CHECK (ok);
+        }
+    });
+}
+
+BOOST_AUTO_TEST_CASE(testParallelReduce) {
+    // Floating point sums depend on the order of the operations
+    std::vector<double> values;
+    std::mt19937 rengine(1);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (int i=0; i<100000; ++i) {
+        values.push_back(std::pow(10.0, 10 * dist(rengine)));
+    }
+    auto value = [&](Size i) { return values[i]; };
+    auto sum = [](double a, double b) { return a + b; };
+
+    std::vector<double> results;
+    forEachSchedule([&]() {
+        for (Size grain : {1u, 100u, 4096u}) {
+            results.push_back(parallelReduce(0, values.size(), grain, 0.0, value, sum));
+        }
+    });
+    for (Size i=3; i<results.size(); ++i) {
+        BOOST_CHECK_EQUAL (results[i], results[i % 3]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testTaskGroups) {
+    forEachSchedule([]() {
+        BOOST_CHECK_EQUAL (fibonacci(20), 6765u);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(testExclusiveScan) {
+    forEachSchedule([]() {
+        for (Size n : {0u, 1u, 4096u, 100001u}) {
+            std::vector<FlatSize> values(n);
+            for (Size i=0; i<n; ++i) {
+                values[i] = i % 7;
+            }
+            FlatSize total = parallelExclusiveScan(values);
+            FlatSize expected = 0;
+            bool ok = true;
+            for (Size i=0; i<n; ++i) {
+                ok = ok && values[i] == expected;
+                expected += i % 7;
+            }
+            BOOST_CHECK (ok);
+            BOOST_CHECK_EQUAL (total, expected);
+        }
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+